@@ -0,0 +1,1111 @@
+//
+//		ShaderBench.cpp
+//
+//		A headless benchmark host for the ShaderLoader FreeFrameGL plugin.
+//
+//		The plugin dll is loaded and driven through plugMain exactly as a host
+//		such as Resolume or Isadora would do it : FF_INSTANTIATEGL, FF_SETPARAMETER
+//		and then FF_PROCESSOPENGL for a number of frames at each resolution requested.
+//		Rendering is into an offscreen fbo of a hidden window's OpenGL context,
+//		so nothing is shown on screen.
+//
+//		For every frame the CPU time of the FF_PROCESSOPENGL call and the GPU time
+//		measured with a GL_TIME_ELAPSED query are recorded and the mean and
+//		percentiles are reported for each resolution.
+//
+//		Usage :
+//
+//		ShaderBench -shader <file> [-plugin <dll>] [-frames <n>] [-warmup <n>]
+//		            [-size <width>x<height>] [-inputs <n>] [-param <index>=<value>]
+//		            [-step <seconds>]
+//
+//		ShaderBench -corpus <folder> -baseline <file.json> [-write] [-tolerance <percent>]
+//		            [-nochecksum] [options as above]
+//
+//		ShaderBench -translate <folder>
+//
+//		-size and -param can be repeated. The default is 300 frames at 1280x720
+//		after 30 warm-up frames.
+//
+//		-param indices are those of the plugin : 5 Speed, 6 X mouse, 7 Y mouse,
+//		8 X mouse left, 9 Y mouse left, 10 Red, 11 Green, 12 Blue, 13 Alpha,
+//		14 Frame budget, 15 Checkerboard, 16 Render rate and 17 Tile budget.
+//
+//		-step drives the plugin time through FF_SETTIME with a fixed time step
+//		instead of the plugin's own clock, so that every run renders the same frames.
+//
+//		Corpus mode runs every shader file in the folder and its sub-folders
+//		(e.g. Shaders, "Shaders/More shaders" and Shaders/Revised) at the first size,
+//		with a fixed time step of 1/60 second unless -step is given.
+//		With -write the load time, ms/frame and output checksum of each shader are
+//		written to the baseline file. Otherwise they are compared with the baseline
+//		and the exit code is non-zero if any shader is slower than the baseline by
+//		more than the tolerance (default 15%), renders a different image, fails
+//		or is missing from the baseline.
+//
+//		-translate checks the core profile translation of every shader file in the
+//		folder and its sub-folders without the plugin. Each file is given the uniform
+//		block and main function that the plugin adds to a ShaderToy file, translated
+//		as the plugin does on a core profile context and compiled on an OpenGL 3.3
+//		core profile context. The exit code is non-zero if any translation does not
+//		start with "#version 330 core" or does not compile.
+//
+//		------------------------------------------------------------
+//		Revisions :
+//		17-10-26	Version 1.000
+//		17-10-26	Corpus mode with a json baseline for regression testing
+//					Fixed time step through FF_SETTIME
+//					Version 1.001
+//		17-10-26	Core profile translation check of a corpus with -translate
+//					Version 1.002
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification,
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice,
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice,
+//		   this list of conditions and the following disclaimer in the documentation
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED.
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#include <FFGL.h>
+#include <ShaderParser.h>
+#include <ShaderTranslator.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+
+#define FFPARAM_FILENAME    (0)
+#define FFPARAM_RELOAD      (4) // displays "Compiling" until the shader is in use
+
+// How long a shader can take to compile before the run fails
+#define MAX_LOAD_TIME       (30000.0) // msec
+
+#define MAX_BENCH_INPUTS    (4)
+
+// Differences below these are treated as noise whatever the tolerance
+#define MIN_FRAME_REGRESSION  (0.05) // msec
+#define MIN_LOAD_REGRESSION   (5.0)  // msec
+
+struct BenchSize {
+	int width;
+	int height;
+};
+
+struct BenchParam {
+	unsigned int index;
+	float value;
+};
+
+struct BenchStats {
+	double mean;
+	double p50;
+	double p90;
+	double p99;
+	double max;
+};
+
+struct BenchResult {
+	std::string name;      // Shader name relative to the corpus folder
+	bool bSuccess;         // All frames rendered
+	bool bGpuTime;         // GPU times are valid
+	int nFrames;           // Frames timed
+	double loadTime;       // msec to load the shader and render the first frame
+	double frameTime;      // median msec per frame, GPU if available otherwise CPU
+	unsigned int checksum; // of the last frame rendered
+	BenchStats cpu;
+	BenchStats gpu;
+};
+
+// The plugin entry point
+static HMODULE g_hPlugin = NULL;
+static FF_Main_FuncPtr g_plugMain = NULL;
+
+// Hidden window and OpenGL context
+static HWND  g_hWnd = NULL;
+static HDC   g_hDC  = NULL;
+static HGLRC g_hRC  = NULL;
+
+// Offscreen render target standing in for the host output
+static GLuint g_hostFbo = 0;
+static GLuint g_hostTexture = 0;
+
+// Input textures standing in for the host clips
+static FFGLTextureStruct g_inputTextures[MAX_BENCH_INPUTS];
+static FFGLTextureStruct *g_inputPointers[MAX_BENCH_INPUTS];
+
+static double g_PCFreq = 0.0;
+
+
+static double GetMilliseconds()
+{
+	LARGE_INTEGER li;
+	if(g_PCFreq == 0.0) {
+		QueryPerformanceFrequency(&li);
+		g_PCFreq = double(li.QuadPart)/1000.0;
+	}
+	QueryPerformanceCounter(&li);
+	return double(li.QuadPart)/g_PCFreq;
+}
+
+static BenchStats GetStats(std::vector<double> samples)
+{
+	BenchStats stats;
+	memset(&stats, 0, sizeof(stats));
+	if(samples.empty())
+		return stats;
+
+	std::sort(samples.begin(), samples.end());
+
+	double total = 0.0;
+	for(size_t i = 0; i < samples.size(); i++)
+		total += samples[i];
+
+	size_t last = samples.size()-1;
+	stats.mean = total/(double)samples.size();
+	stats.p50  = samples[(size_t)(0.50*last + 0.5)];
+	stats.p90  = samples[(size_t)(0.90*last + 0.5)];
+	stats.p99  = samples[(size_t)(0.99*last + 0.5)];
+	stats.max  = samples[last];
+
+	return stats;
+}
+
+static LRESULT CALLBACK BenchWndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+	return DefWindowProcA(hWnd, msg, wParam, lParam);
+}
+
+//
+// A hidden window is the simplest way to get a compatibility profile
+// context from WGL. Nothing is ever drawn to it. A core profile context
+// is made with WGL_ARB_create_context once the first one is current.
+//
+static bool CreateGLContext(bool bCore = false)
+{
+	WNDCLASSA wc;
+	PIXELFORMATDESCRIPTOR pfd;
+	int format;
+
+	memset(&wc, 0, sizeof(wc));
+	wc.style         = CS_OWNDC;
+	wc.lpfnWndProc   = BenchWndProc;
+	wc.hInstance     = GetModuleHandle(NULL);
+	wc.lpszClassName = "ShaderBench";
+	RegisterClassA(&wc);
+
+	g_hWnd = CreateWindowA("ShaderBench", "ShaderBench", WS_POPUP, 0, 0, 16, 16, NULL, NULL, wc.hInstance, NULL);
+	if(!g_hWnd) {
+		printf("Could not create window\n");
+		return false;
+	}
+
+	g_hDC = GetDC(g_hWnd);
+
+	memset(&pfd, 0, sizeof(pfd));
+	pfd.nSize      = sizeof(pfd);
+	pfd.nVersion   = 1;
+	pfd.dwFlags    = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER;
+	pfd.iPixelType = PFD_TYPE_RGBA;
+	pfd.cColorBits = 32;
+	pfd.cDepthBits = 24;
+	pfd.iLayerType = PFD_MAIN_PLANE;
+	format = ChoosePixelFormat(g_hDC, &pfd);
+	if(!format || !SetPixelFormat(g_hDC, format, &pfd)) {
+		printf("Could not set pixel format\n");
+		return false;
+	}
+
+	g_hRC = wglCreateContext(g_hDC);
+	if(!g_hRC || !wglMakeCurrent(g_hDC, g_hRC)) {
+		printf("Could not create OpenGL context\n");
+		return false;
+	}
+
+	if(bCore) {
+		const int attributes[] = { WGL_CONTEXT_MAJOR_VERSION_ARB, 3,
+								   WGL_CONTEXT_MINOR_VERSION_ARB, 3,
+								   WGL_CONTEXT_PROFILE_MASK_ARB, WGL_CONTEXT_CORE_PROFILE_BIT_ARB,
+								   0 };
+		HGLRC hCoreRC = GLEE_WGL_ARB_create_context ? wglCreateContextAttribsARB(g_hDC, NULL, attributes) : NULL;
+		if(!hCoreRC) {
+			printf("Could not create an OpenGL 3.3 core profile context\n");
+			return false;
+		}
+		wglMakeCurrent(NULL, NULL);
+		wglDeleteContext(g_hRC);
+		g_hRC = hCoreRC;
+		if(!wglMakeCurrent(g_hDC, g_hRC)) {
+			printf("Could not make the core profile context current\n");
+			return false;
+		}
+	}
+
+	printf("GL_RENDERER [%s]\n", glGetString(GL_RENDERER));
+	printf("GL_VERSION  [%s]\n", glGetString(GL_VERSION));
+
+	return true;
+}
+
+static void ReleaseGLContext()
+{
+	wglMakeCurrent(NULL, NULL);
+	if(g_hRC) wglDeleteContext(g_hRC);
+	if(g_hDC) ReleaseDC(g_hWnd, g_hDC);
+	if(g_hWnd) DestroyWindow(g_hWnd);
+	g_hRC  = NULL;
+	g_hDC  = NULL;
+	g_hWnd = NULL;
+}
+
+//
+// Output fbo and input textures for one resolution.
+// The input textures carry a test pattern so that filters have something to work on.
+//
+static void CreateTargets(int width, int height, int nInputs)
+{
+	std::vector<unsigned char> pattern(width*height*4);
+
+	glGenTextures(1, &g_hostTexture);
+	glBindTexture(GL_TEXTURE_2D, g_hostTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glGenFramebuffersEXT(1, &g_hostFbo);
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, g_hostFbo);
+	glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, g_hostTexture, 0);
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+
+	for(int i = 0; i < nInputs; i++) {
+		for(int y = 0; y < height; y++) {
+			for(int x = 0; x < width; x++) {
+				unsigned char *p = &pattern[(y*width + x)*4];
+				bool check = (((x >> 5) + (y >> 5) + i) & 1) != 0;
+				p[0] = (unsigned char)(x*255/width);
+				p[1] = (unsigned char)(y*255/height);
+				p[2] = check ? 255 : 0;
+				p[3] = 255;
+			}
+		}
+		GLuint texture = 0;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pattern[0]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		g_inputTextures[i].Width          = width;
+		g_inputTextures[i].Height         = height;
+		g_inputTextures[i].HardwareWidth  = width;
+		g_inputTextures[i].HardwareHeight = height;
+		g_inputTextures[i].Handle         = texture;
+		g_inputPointers[i] = &g_inputTextures[i];
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+static void ReleaseTargets(int nInputs)
+{
+	for(int i = 0; i < nInputs; i++) {
+		if(g_inputTextures[i].Handle) glDeleteTextures(1, &g_inputTextures[i].Handle);
+		g_inputTextures[i].Handle = 0;
+	}
+	if(g_hostFbo) glDeleteFramebuffersEXT(1, &g_hostFbo);
+	if(g_hostTexture) glDeleteTextures(1, &g_hostTexture);
+	g_hostFbo = 0;
+	g_hostTexture = 0;
+}
+
+//
+// FNV-1a hash of the host fbo contents after the last frame
+//
+static unsigned int GetChecksum(int width, int height)
+{
+	std::vector<unsigned char> pixels(width*height*4);
+	unsigned int hash = 2166136261u;
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	for(size_t i = 0; i < pixels.size(); i++) {
+		hash ^= pixels[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static FFMixed CallPlugin(FFUInt32 functionCode, FFMixed inputValue, FFInstanceID instanceID)
+{
+	return g_plugMain(functionCode, inputValue, instanceID);
+}
+
+static bool SetTextParameter(FFInstanceID instance, unsigned int index, const char *value)
+{
+	SetParameterStruct param;
+	FFMixed input;
+
+	param.ParameterNumber = index;
+	param.NewParameterValue.PointerValue = (void *)value;
+	input.PointerValue = &param;
+
+	return CallPlugin(FF_SETPARAMETER, input, instance).UIntValue == FF_SUCCESS;
+}
+
+static bool SetFloatParameter(FFInstanceID instance, unsigned int index, float value)
+{
+	SetParameterStruct param;
+	FFMixed input;
+
+	param.ParameterNumber = index;
+	param.NewParameterValue.UIntValue = *(FFUInt32 *)&value;
+	input.PointerValue = &param;
+
+	return CallPlugin(FF_SETPARAMETER, input, instance).UIntValue == FF_SUCCESS;
+}
+
+static bool IsShaderPending(FFInstanceID instance)
+{
+	FFMixed input;
+	input.UIntValue = FFPARAM_RELOAD;
+	const char *display = (const char *)CallPlugin(FF_GETPARAMETERDISPLAY, input, instance).PointerValue;
+	return display != NULL && (size_t)display != (size_t)FF_FAIL && strcmp(display, "Compiling") == 0;
+}
+
+static bool SetTime(FFInstanceID instance, double time)
+{
+	FFMixed input;
+	input.PointerValue = &time;
+	return CallPlugin(FF_SETTIME, input, instance).UIntValue == FF_SUCCESS;
+}
+
+//
+// Run one instance of the plugin at one resolution and collect the timings.
+// If timeStep is greater than zero the plugin time is set for every frame,
+// otherwise the plugin runs from its own clock.
+//
+static bool RunBenchmark(const char *shaderPath, BenchSize size, int nInputs, int nWarmup, int nFrames,
+						 double timeStep, const std::vector<BenchParam> &params, BenchResult &result)
+{
+	FFGLViewportStruct viewport;
+	ProcessOpenGLStruct processStruct;
+	FFInstanceID instance;
+	FFMixed input;
+	FFResult ffresult;
+	std::vector<double> cpuTimes;
+	std::vector<double> gpuTimes;
+	std::vector<GLuint> queries;
+	bool bTimerQuery = GLEE_ARB_timer_query ? true : false;
+
+	result.bSuccess  = false;
+	result.bGpuTime  = false;
+	result.nFrames   = 0;
+	result.loadTime  = 0.0;
+	result.frameTime = 0.0;
+	result.checksum  = 0;
+	memset(&result.cpu, 0, sizeof(result.cpu));
+	memset(&result.gpu, 0, sizeof(result.gpu));
+
+	CreateTargets(size.width, size.height, nInputs);
+
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, g_hostFbo);
+	glViewport(0, 0, size.width, size.height);
+
+	viewport.x      = 0;
+	viewport.y      = 0;
+	viewport.width  = size.width;
+	viewport.height = size.height;
+	input.PointerValue = &viewport;
+	instance = CallPlugin(FF_INSTANTIATEGL, input, NULL).PointerValue;
+	if(instance == NULL || (size_t)instance == (size_t)FF_FAIL) {
+		printf("FF_INSTANTIATEGL failed\n");
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+		ReleaseTargets(nInputs);
+		return false;
+	}
+
+	processStruct.numInputTextures = nInputs;
+	processStruct.inputTextures    = nInputs > 0 ? g_inputPointers : NULL;
+	processStruct.HostFBO          = g_hostFbo;
+
+	// The load time covers the shader file load and the frames up to the one that swaps
+	// in the compiled shader. If the driver compiles in parallel the plugin keeps
+	// rendering the previous shader until then, so frames are drawn until it is in use.
+	double loadStart = GetMilliseconds();
+
+	SetTextParameter(instance, FFPARAM_FILENAME, shaderPath);
+	for(size_t i = 0; i < params.size(); i++)
+		SetFloatParameter(instance, params[i].index, params[i].value);
+
+	if(timeStep > 0.0)
+		SetTime(instance, 0.0);
+
+	glClear(GL_COLOR_BUFFER_BIT);
+	input.PointerValue = &processStruct;
+	ffresult = CallPlugin(FF_PROCESSOPENGL, input, instance).UIntValue;
+	while(ffresult == FF_SUCCESS && IsShaderPending(instance)
+	   && GetMilliseconds() - loadStart < MAX_LOAD_TIME) {
+		glClear(GL_COLOR_BUFFER_BIT);
+		ffresult = CallPlugin(FF_PROCESSOPENGL, input, instance).UIntValue;
+	}
+	glFinish();
+	result.loadTime = GetMilliseconds() - loadStart;
+
+	if(ffresult != FF_SUCCESS) {
+		printf("FF_PROCESSOPENGL failed on the first frame\n");
+		nWarmup = nFrames = 0;
+	}
+	else if(IsShaderPending(instance)) {
+		printf("The shader was still compiling after %.0f ms\n", result.loadTime);
+		nWarmup = nFrames = 0;
+	}
+
+	if(bTimerQuery && nFrames > 0) {
+		queries.resize(nFrames);
+		glGenQueries(nFrames, &queries[0]);
+	}
+
+	for(int frame = 0; frame < nWarmup + nFrames; frame++) {
+
+		int sample = frame - nWarmup;
+
+		if(timeStep > 0.0)
+			SetTime(instance, (double)(frame + 1)*timeStep);
+
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, g_hostFbo);
+		glViewport(0, 0, size.width, size.height);
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		if(bTimerQuery && sample >= 0)
+			glBeginQuery(GL_TIME_ELAPSED, queries[sample]);
+
+		double start = GetMilliseconds();
+		input.PointerValue = &processStruct;
+		ffresult = CallPlugin(FF_PROCESSOPENGL, input, instance).UIntValue;
+		double cpu = GetMilliseconds() - start;
+
+		if(bTimerQuery && sample >= 0)
+			glEndQuery(GL_TIME_ELAPSED);
+
+		if(ffresult != FF_SUCCESS) {
+			printf("FF_PROCESSOPENGL failed on frame %d\n", frame);
+			break;
+		}
+
+		if(sample >= 0)
+			cpuTimes.push_back(cpu);
+	}
+
+	// Collect the GPU times once everything has been submitted
+	// so that reading them back does not stall the frame loop
+	glFinish();
+	if(bTimerQuery && nFrames > 0) {
+		for(size_t i = 0; i < cpuTimes.size(); i++) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+			gpuTimes.push_back((double)elapsed/1000000.0);
+		}
+		glDeleteQueries(nFrames, &queries[0]);
+	}
+
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, g_hostFbo);
+	result.checksum = GetChecksum(size.width, size.height);
+
+	CallPlugin(FF_DEINSTANTIATEGL, input, instance);
+
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+	ReleaseTargets(nInputs);
+
+	result.cpu       = GetStats(cpuTimes);
+	result.gpu       = GetStats(gpuTimes);
+	result.bGpuTime  = !gpuTimes.empty();
+	result.nFrames   = (int)cpuTimes.size();
+	result.frameTime = result.bGpuTime ? result.gpu.p50 : result.cpu.p50;
+	result.bSuccess  = nFrames > 0 && (int)cpuTimes.size() == nFrames;
+
+	return result.bSuccess;
+}
+
+static void PrintResult(BenchSize size, const BenchResult &result)
+{
+	printf("%dx%d  %d frames  load %.3f ms  checksum %08x\n",
+		size.width, size.height, result.nFrames, result.loadTime, result.checksum);
+	printf("    ProcessOpenGL CPU ms  mean %7.3f  p50 %7.3f  p90 %7.3f  p99 %7.3f  max %7.3f\n",
+		result.cpu.mean, result.cpu.p50, result.cpu.p90, result.cpu.p99, result.cpu.max);
+	if(result.bGpuTime)
+		printf("    ProcessOpenGL GPU ms  mean %7.3f  p50 %7.3f  p90 %7.3f  p99 %7.3f  max %7.3f\n",
+			result.gpu.mean, result.gpu.p50, result.gpu.p90, result.gpu.p99, result.gpu.max);
+	else
+		printf("    GPU timer queries not supported\n");
+}
+
+//
+// Find all the shader files in a folder and its sub-folders.
+// Names are returned relative to the corpus folder with '/' separators
+// so that a baseline can be used from any location.
+//
+static void FindShaders(const std::string &folder, const std::string &relative, std::vector<std::string> &names)
+{
+	WIN32_FIND_DATAA fd;
+	HANDLE hFind;
+	std::string search = folder;
+
+	if(!relative.empty())
+		search += "\\" + relative;
+	search += "\\*";
+
+	hFind = FindFirstFileA(search.c_str(), &fd);
+	if(hFind == INVALID_HANDLE_VALUE)
+		return;
+
+	do {
+		std::string name = fd.cFileName;
+		std::string path = relative.empty() ? name : relative + "/" + name;
+		if(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+			if(name != "." && name != "..")
+				FindShaders(folder, path, names);
+		}
+		else if(name.size() > 4 && _stricmp(name.c_str() + name.size() - 4, ".txt") == 0
+			&& _stricmp(name.c_str(), "README.TXT") != 0 && _stricmp(name.c_str(), "LICENCE.TXT") != 0) {
+			names.push_back(path);
+		}
+	} while(FindNextFileA(hFind, &fd));
+
+	FindClose(hFind);
+}
+
+static std::string JsonEscape(const std::string &text)
+{
+	std::string escaped;
+	for(size_t i = 0; i < text.size(); i++) {
+		if(text[i] == '"' || text[i] == '\\')
+			escaped += '\\';
+		escaped += text[i];
+	}
+	return escaped;
+}
+
+//
+// The baseline is written with one shader per line so that
+// it can be read back without a general json parser.
+//
+static bool WriteBaseline(const char *path, BenchSize size, int nFrames, double timeStep,
+						  const std::vector<BenchResult> &results)
+{
+	FILE *file = NULL;
+	if(fopen_s(&file, path, "w") != 0 || !file) {
+		printf("Could not write baseline [%s]\n", path);
+		return false;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"renderer\": \"%s\",\n", JsonEscape((const char *)glGetString(GL_RENDERER)).c_str());
+	fprintf(file, "  \"version\": \"%s\",\n", JsonEscape((const char *)glGetString(GL_VERSION)).c_str());
+	fprintf(file, "  \"width\": %d,\n", size.width);
+	fprintf(file, "  \"height\": %d,\n", size.height);
+	fprintf(file, "  \"frames\": %d,\n", nFrames);
+	fprintf(file, "  \"step\": %.6f,\n", timeStep);
+	fprintf(file, "  \"shaders\": [\n");
+	for(size_t i = 0; i < results.size(); i++) {
+		const BenchResult &result = results[i];
+		fprintf(file, "    { \"name\": \"%s\", \"ok\": %s, \"load_ms\": %.3f, \"frame_ms\": %.4f, \"cpu_ms\": %.4f, \"gpu_ms\": %.4f, \"checksum\": \"%08x\" }%s\n",
+			JsonEscape(result.name).c_str(), result.bSuccess ? "true" : "false",
+			result.loadTime, result.frameTime, result.cpu.p50, result.gpu.p50,
+			result.checksum, i + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+	fclose(file);
+
+	printf("Baseline written to [%s]\n", path);
+
+	return true;
+}
+
+static bool GetJsonString(const char *line, const char *key, std::string &value)
+{
+	std::string search = std::string("\"") + key + "\": \"";
+	const char *p = strstr(line, search.c_str());
+	if(!p)
+		return false;
+	value.clear();
+	for(p += search.size(); *p && *p != '"'; p++) {
+		if(*p == '\\' && p[1]) p++;
+		value += *p;
+	}
+	return true;
+}
+
+static bool GetJsonNumber(const char *line, const char *key, double &value)
+{
+	std::string search = std::string("\"") + key + "\": ";
+	const char *p = strstr(line, search.c_str());
+	if(!p)
+		return false;
+	value = atof(p + search.size());
+	return true;
+}
+
+static bool ReadBaseline(const char *path, std::vector<BenchResult> &results)
+{
+	FILE *file = NULL;
+	char line[1024];
+
+	if(fopen_s(&file, path, "r") != 0 || !file) {
+		printf("Could not read baseline [%s]\n", path);
+		return false;
+	}
+
+	while(fgets(line, 1024, file)) {
+		BenchResult result;
+		std::string checksum;
+		memset(&result.cpu, 0, sizeof(result.cpu));
+		memset(&result.gpu, 0, sizeof(result.gpu));
+		if(!GetJsonString(line, "name", result.name))
+			continue;
+		result.bSuccess = strstr(line, "\"ok\": true") != NULL;
+		result.bGpuTime = false;
+		result.nFrames  = 0;
+		GetJsonNumber(line, "load_ms", result.loadTime);
+		GetJsonNumber(line, "frame_ms", result.frameTime);
+		GetJsonNumber(line, "cpu_ms", result.cpu.p50);
+		GetJsonNumber(line, "gpu_ms", result.gpu.p50);
+		GetJsonString(line, "checksum", checksum);
+		result.checksum = (unsigned int)strtoul(checksum.c_str(), NULL, 16);
+		results.push_back(result);
+	}
+	fclose(file);
+
+	return true;
+}
+
+static bool IsRegression(double current, double baseline, double tolerance, double minimum)
+{
+	return current > baseline*(1.0 + tolerance/100.0) && current - baseline > minimum;
+}
+
+//
+// Compare the corpus results with the baseline and report every difference.
+// Returns the number of shaders that failed.
+//
+static int CompareBaseline(const std::vector<BenchResult> &results, const std::vector<BenchResult> &baseline,
+						   double tolerance, bool bChecksum)
+{
+	int nFailed = 0;
+
+	printf("\n%-60s %10s %10s %10s %10s\n", "Shader", "load ms", "base", "frame ms", "base");
+
+	for(size_t i = 0; i < results.size(); i++) {
+		const BenchResult &result = results[i];
+		const BenchResult *base = NULL;
+		std::string failure;
+
+		for(size_t j = 0; j < baseline.size(); j++) {
+			if(baseline[j].name == result.name) {
+				base = &baseline[j];
+				break;
+			}
+		}
+
+		if(!base) {
+			failure = "not in baseline";
+		}
+		else if(!result.bSuccess && base->bSuccess) {
+			failure = "failed";
+		}
+		else {
+			if(IsRegression(result.frameTime, base->frameTime, tolerance, MIN_FRAME_REGRESSION))
+				failure += "slower ";
+			if(IsRegression(result.loadTime, base->loadTime, tolerance, MIN_LOAD_REGRESSION))
+				failure += "slower load ";
+			if(bChecksum && result.checksum != base->checksum)
+				failure += "output changed";
+		}
+
+		printf("%-60s %10.3f %10.3f %10.4f %10.4f  %s\n", result.name.c_str(),
+			result.loadTime, base ? base->loadTime : 0.0,
+			result.frameTime, base ? base->frameTime : 0.0,
+			failure.empty() ? "ok" : failure.c_str());
+
+		if(!failure.empty())
+			nFailed++;
+	}
+
+	return nFailed;
+}
+
+//
+// Run every shader in the corpus folder at one resolution and
+// write the results as the baseline or compare them with it
+//
+static bool RunCorpus(const char *corpusPath, const char *baselinePath, bool bWrite, double tolerance, bool bChecksum,
+					  BenchSize size, int nInputs, int nWarmup, int nFrames, double timeStep,
+					  const std::vector<BenchParam> &params)
+{
+	std::vector<std::string> names;
+	std::vector<BenchResult> results;
+	std::vector<BenchResult> baseline;
+	char shaderPath[MAX_PATH];
+
+	FindShaders(corpusPath, "", names);
+	std::sort(names.begin(), names.end());
+	if(names.empty()) {
+		printf("No shader files found in [%s]\n", corpusPath);
+		return false;
+	}
+
+	if(!bWrite && !ReadBaseline(baselinePath, baseline))
+		return false;
+
+	printf("Corpus [%s] %d shaders at %dx%d, %d frames, time step %.4f sec\n",
+		corpusPath, (int)names.size(), size.width, size.height, nFrames, timeStep);
+
+	for(size_t i = 0; i < names.size(); i++) {
+		BenchResult result;
+		std::string path = std::string(corpusPath) + "/" + names[i];
+		std::replace(path.begin(), path.end(), '/', '\\');
+		GetFullPathNameA(path.c_str(), MAX_PATH, shaderPath, NULL);
+
+		printf("\n[%d/%d] %s\n", (int)(i + 1), (int)names.size(), names[i].c_str());
+		RunBenchmark(shaderPath, size, nInputs, nWarmup, nFrames, timeStep, params, result);
+		result.name = names[i];
+		PrintResult(size, result);
+		results.push_back(result);
+	}
+
+	if(bWrite)
+		return WriteBaseline(baselinePath, size, nFrames, timeStep, results);
+
+	int nFailed = CompareBaseline(results, baseline, tolerance, bChecksum);
+	printf("\n%d of %d shaders regressed (tolerance %.1f%%)\n", nFailed, (int)results.size(), tolerance);
+
+	return nFailed == 0;
+}
+
+//
+// The core profile translation of a shader file, as the plugin makes it. A
+// ShaderToy file is given the ShaderLoaderGlobals block, the samplers and the
+// main function calling mainImage, which the translator leaves as they are.
+//
+static bool TranslateShader(const std::string &source, std::string &translated, bool &bTranslated)
+{
+	static const char *stoyUniforms[][2] = {
+		{ "iResolution",        "#define iResolution sl_Resolution\n" },
+		{ "iGlobalTime",        "#define iGlobalTime sl_Time\n" },
+		{ "iTime",              "#define iTime sl_Time\n" },
+		{ "iTimeDelta",         "#define iTimeDelta sl_TimeDelta\n" },
+		{ "iFrame",             "#define iFrame sl_Frame\n" },
+		{ "iMouse",             "#define iMouse sl_Mouse\n" },
+		{ "iDate",              "#define iDate sl_Date\n" },
+		{ "iChannelTime",       "#define iChannelTime sl_ChannelTime\n" },
+		{ "iChannelResolution", "#define iChannelResolution sl_ChannelResolution\n" },
+		{ "inputColour",        "#define inputColour sl_InputColour\n" },
+		{ "iChannel0",          "uniform sampler2D iChannel0;\n" },
+		{ "iChannel1",          "uniform sampler2D iChannel1;\n" },
+		{ "iChannel2",          "uniform sampler2D iChannel2;\n" },
+		{ "iChannel3",          "uniform sampler2D iChannel3;\n" },
+	};
+	static const char *globalsBlock = { "#extension GL_ARB_uniform_buffer_object : enable\n"
+										"layout(std140) uniform ShaderLoaderGlobals {\n"
+										"    vec3 sl_Resolution;\n"
+										"    float sl_Time;\n"
+										"    vec4 sl_Mouse;\n"
+										"    vec4 sl_Date;\n"
+										"    vec4 sl_InputColour;\n"
+										"    vec4 sl_ChannelTime;\n"
+										"    vec3 sl_ChannelResolution[4];\n"
+										"    vec4 sl_ChannelScale[4];\n"
+										"    float sl_TimeDelta;\n"
+										"    int sl_Frame;\n"
+										"};\n" };
+	static const char *stoyMainFunction = { "\nvoid main(void) {\n"
+											"    mainImage(gl_FragColor, gl_FragCoord.xy);\n"
+											"}\n" };
+
+	ShaderParser parser;
+	ShaderTranslator translator;
+	ShaderTranslator::Ranges injected;
+	std::string header;
+	std::string joined;
+
+	if(!parser.Parse(source))
+		return false;
+
+	if(parser.GetDialect() == ShaderParser::DIALECT_SHADERTOY) {
+		header = globalsBlock;
+		for(int i = 0; i < sizeof(stoyUniforms)/sizeof(stoyUniforms[0]); i++) {
+			if(parser.IsReferenced(stoyUniforms[i][0]) && !parser.IsDeclared(stoyUniforms[i][0]))
+				header += stoyUniforms[i][1];
+		}
+	}
+
+	size_t bodyStart = parser.GetBodyStart();
+	joined.assign(source, 0, bodyStart);
+	injected.push_back(std::make_pair(joined.size(), joined.size() + header.size()));
+	joined += header;
+	joined.append(source, bodyStart, std::string::npos);
+	if(parser.GetDialect() == ShaderParser::DIALECT_SHADERTOY && parser.HasMainImage() && !parser.HasMain()) {
+		injected.push_back(std::make_pair(joined.size(), joined.size() + strlen(stoyMainFunction)));
+		joined += stoyMainFunction;
+	}
+
+	// GLSL 3.30 or later is compiled as it is
+	bTranslated = translator.Translate(joined, translated, &injected);
+	if(!bTranslated)
+		translated = joined;
+
+	return true;
+}
+
+//
+// Translate every shader file in a folder and compile it on the core profile context
+//
+static bool RunTranslation(const char *corpusPath)
+{
+	std::vector<std::string> names;
+	int nFailed = 0;
+	int nChecked = 0;
+
+	FindShaders(corpusPath, "", names);
+	std::sort(names.begin(), names.end());
+	if(names.empty()) {
+		printf("No shader files found in [%s]\n", corpusPath);
+		return false;
+	}
+
+	for(size_t i = 0; i < names.size(); i++) {
+		std::string path = std::string(corpusPath) + "/" + names[i];
+		std::string source;
+		std::string translated;
+		bool bTranslated = false;
+		char buffer[4096];
+		size_t length;
+		FILE *file = NULL;
+
+		std::replace(path.begin(), path.end(), '/', '\\');
+		if(fopen_s(&file, path.c_str(), "rb") != 0 || file == NULL) {
+			printf("%s : could not be read\n", names[i].c_str());
+			nFailed++;
+			continue;
+		}
+		while((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			source.append(buffer, length);
+		fclose(file);
+
+		// A file without a main function, such as a buffer of a multipass shader, is not loaded on its own
+		if(!TranslateShader(source, translated, bTranslated))
+			continue;
+		nChecked++;
+
+		if(bTranslated && translated.compare(0, 18, "#version 330 core\n") != 0) {
+			printf("%s : the translation does not start with #version 330 core\n", names[i].c_str());
+			nFailed++;
+			continue;
+		}
+
+		const char *strings[] = { translated.c_str() };
+		GLuint shader = glCreateShader(GL_FRAGMENT_SHADER);
+		GLint status = 0;
+		glShaderSource(shader, 1, strings, NULL);
+		glCompileShader(shader);
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+		if(!status) {
+			char log[4096];
+			log[0] = 0;
+			glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+			printf("%s : compile failed\n%s\n", names[i].c_str(), log);
+			nFailed++;
+		}
+		glDeleteShader(shader);
+	}
+
+	printf("\n%d of %d shaders failed to translate or compile\n", nFailed, nChecked);
+
+	return nFailed == 0;
+}
+
+static void PrintUsage()
+{
+	printf("ShaderBench -shader <file> [-plugin <dll>] [-frames <n>] [-warmup <n>]\n");
+	printf("            [-size <width>x<height>] [-inputs <n>] [-param <index>=<value>]\n");
+	printf("            [-step <seconds>]\n");
+	printf("ShaderBench -corpus <folder> -baseline <file.json> [-write] [-tolerance <percent>]\n");
+	printf("            [-nochecksum] [options as above]\n");
+	printf("ShaderBench -translate <folder>\n");
+}
+
+int main(int argc, char *argv[])
+{
+	char pluginPath[MAX_PATH];
+	char shaderPath[MAX_PATH];
+	char corpusPath[MAX_PATH];
+	char baselinePath[MAX_PATH];
+	char translatePath[MAX_PATH];
+	int nFrames = 300;
+	int nWarmup = 30;
+	int nInputs = 1;
+	double timeStep = 0.0;
+	double tolerance = 15.0;
+	bool bWrite = false;
+	bool bChecksum = true;
+	std::vector<BenchSize> sizes;
+	std::vector<BenchParam> params;
+	bool bResult = true;
+
+	strcpy_s(pluginPath, MAX_PATH, "ShaderLoader.dll");
+	shaderPath[0] = 0;
+	corpusPath[0] = 0;
+	baselinePath[0] = 0;
+	translatePath[0] = 0;
+
+	for(int i = 1; i < argc; i++) {
+		bool bHasValue = (i + 1 < argc);
+		if(strcmp(argv[i], "-plugin") == 0 && bHasValue) {
+			strcpy_s(pluginPath, MAX_PATH, argv[++i]);
+		}
+		else if(strcmp(argv[i], "-shader") == 0 && bHasValue) {
+			// The plugin treats anything that is not a full path as a name in its own folder
+			GetFullPathNameA(argv[++i], MAX_PATH, shaderPath, NULL);
+		}
+		else if(strcmp(argv[i], "-corpus") == 0 && bHasValue) {
+			strcpy_s(corpusPath, MAX_PATH, argv[++i]);
+		}
+		else if(strcmp(argv[i], "-baseline") == 0 && bHasValue) {
+			strcpy_s(baselinePath, MAX_PATH, argv[++i]);
+		}
+		else if(strcmp(argv[i], "-translate") == 0 && bHasValue) {
+			strcpy_s(translatePath, MAX_PATH, argv[++i]);
+		}
+		else if(strcmp(argv[i], "-write") == 0) {
+			bWrite = true;
+		}
+		else if(strcmp(argv[i], "-nochecksum") == 0) {
+			bChecksum = false;
+		}
+		else if(strcmp(argv[i], "-tolerance") == 0 && bHasValue) {
+			tolerance = MAX(0.0, atof(argv[++i]));
+		}
+		else if(strcmp(argv[i], "-step") == 0 && bHasValue) {
+			timeStep = MAX(0.0, atof(argv[++i]));
+		}
+		else if(strcmp(argv[i], "-frames") == 0 && bHasValue) {
+			nFrames = MAX(1, atoi(argv[++i]));
+		}
+		else if(strcmp(argv[i], "-warmup") == 0 && bHasValue) {
+			nWarmup = MAX(0, atoi(argv[++i]));
+		}
+		else if(strcmp(argv[i], "-inputs") == 0 && bHasValue) {
+			nInputs = MIN(MAX(0, atoi(argv[++i])), MAX_BENCH_INPUTS);
+		}
+		else if(strcmp(argv[i], "-size") == 0 && bHasValue) {
+			BenchSize size;
+			if(sscanf_s(argv[++i], "%dx%d", &size.width, &size.height) == 2 && size.width > 0 && size.height > 0)
+				sizes.push_back(size);
+		}
+		else if(strcmp(argv[i], "-param") == 0 && bHasValue) {
+			BenchParam param;
+			if(sscanf_s(argv[++i], "%u=%f", &param.index, &param.value) == 2)
+				params.push_back(param);
+		}
+		else {
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	// The translation check does not use the plugin
+	if(translatePath[0]) {
+		bResult = CreateGLContext(true) && RunTranslation(translatePath);
+		ReleaseGLContext();
+		return bResult ? 0 : 1;
+	}
+
+	// One of a shader or a corpus with a baseline
+	if(corpusPath[0] ? (shaderPath[0] || !baselinePath[0]) : !shaderPath[0]) {
+		PrintUsage();
+		return 1;
+	}
+
+	if(sizes.empty()) {
+		BenchSize size = { 1280, 720 };
+		sizes.push_back(size);
+	}
+
+	// The corpus is always rendered at fixed time steps so that the checksums can be compared
+	if(corpusPath[0] && timeStep <= 0.0)
+		timeStep = 1.0/60.0;
+
+	g_hPlugin = LoadLibraryA(pluginPath);
+	if(!g_hPlugin) {
+		printf("Could not load plugin [%s]\n", pluginPath);
+		return 1;
+	}
+
+	g_plugMain = (FF_Main_FuncPtr)GetProcAddress(g_hPlugin, "plugMain");
+	if(!g_plugMain) {
+		printf("No plugMain entry point in [%s]\n", pluginPath);
+		FreeLibrary(g_hPlugin);
+		return 1;
+	}
+
+	if(!CreateGLContext()) {
+		ReleaseGLContext();
+		FreeLibrary(g_hPlugin);
+		return 1;
+	}
+
+	FFMixed input;
+	input.UIntValue = 0;
+	if(CallPlugin(FF_INITIALISE, input, NULL).UIntValue != FF_SUCCESS) {
+		printf("FF_INITIALISE failed\n");
+		bResult = false;
+	}
+	else {
+		if(timeStep > 0.0) {
+			input.UIntValue = FF_CAP_SETTIME;
+			if(CallPlugin(FF_GETPLUGINCAPS, input, NULL).UIntValue != FF_TRUE)
+				printf("Plugin does not support SetTime - frames will not be repeatable\n");
+			input.UIntValue = 0;
+		}
+
+		if(corpusPath[0]) {
+			bResult = RunCorpus(corpusPath, baselinePath, bWrite, tolerance, bChecksum,
+								sizes[0], nInputs, nWarmup, nFrames, timeStep, params);
+		}
+		else {
+			printf("Shader [%s]\n", shaderPath);
+			for(size_t i = 0; i < sizes.size(); i++) {
+				BenchResult result;
+				if(!RunBenchmark(shaderPath, sizes[i], nInputs, nWarmup, nFrames, timeStep, params, result))
+					bResult = false;
+				PrintResult(sizes[i], result);
+			}
+		}
+		CallPlugin(FF_DEINITIALISE, input, NULL);
+	}
+
+	ReleaseGLContext();
+	FreeLibrary(g_hPlugin);
+
+	return bResult ? 0 : 1;
+}
@@ -23,11 +23,43 @@ void FFGLExtensions::Initialize()
   InitWGLEXTSwapControl();
 #endif
 
+  //first, as a core profile has none of the legacy entry points
+  InitCoreProfile();
   InitMultitexture();
   InitARBShaderObjects();
   InitEXTFramebufferObject();
 }
 
+//a core profile context has no extension string, so from OpenGL 3.0
+//the extensions are listed one at a time with glGetStringi
+int FFGLExtensions::HasExtension(const char *name)
+{
+  const char *version = (const char *)glGetString(GL_VERSION);
+  size_t length = strlen(name);
+
+  if (version!=NULL && atoi(version) >= 3)
+  {
+    GLint numExtensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+    for (GLint i = 0; i < numExtensions; i++)
+    {
+      const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+      if (extension!=NULL && strcmp(extension, name)==0)
+        return 1;
+    }
+    return 0;
+  }
+
+  //a whole name in the extension string, not the start of a longer one
+  const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+  for (const char *p = extensions; p!=NULL && (p = strstr(p, name))!=NULL; p += length)
+  {
+    if ((p==extensions || p[-1]==' ') && (p[length]==' ' || p[length]==0))
+      return 1;
+  }
+  return 0;
+}
+
 void *FFGLExtensions::GetProcAddress(const char *name)
 {
 
@@ -48,7 +80,7 @@ void *FFGLExtensions::GetProcAddress(const char *name)
   if (symbolLength>sizeof(symbolName))
   {
     //symbol name too long;
-    throw;
+    throw 0;
     return NULL;
   }
   
@@ -81,7 +113,7 @@ void *FFGLExtensions::GetProcAddress(const char *name)
 #endif
 #endif
 #endif
-  throw;//this will be caught by one of the Init() functions below
+  throw 0;//this will be caught by one of the Init() functions below
   return NULL;
 }
 
@@ -90,6 +122,14 @@ void FFGLExtensions::InitMultitexture()
   try
   {  
   glActiveTexture = (glActiveTexturePROC)GetProcAddress("glActiveTexture");
+
+  //the rest are not in a core profile
+  if (CoreProfile)
+  {
+    multitexture = 0;
+    return;
+  }
+
   glClientActiveTexture = (glClientActiveTexturePROC)GetProcAddress("glClientActiveTexture");
 
   glMultiTexCoord1d = (glMultiTexCoord1dPROC)GetProcAddress("glMultiTexCoord1d");
@@ -142,6 +182,13 @@ void FFGLExtensions::InitMultitexture()
 
 void FFGLExtensions::InitARBShaderObjects()
 {
+  //not in a core profile, where the OpenGL 2.0 calls are used
+  if (CoreProfile)
+  {
+    ARB_shader_objects = 0;
+    return;
+  }
+
   try
   {
 
@@ -198,28 +245,44 @@ void FFGLExtensions::InitARBShaderObjects()
   ARB_shader_objects = 1;
 }
 
+//the EXT name, or the name in core on a core profile context, where
+//drivers need not have the EXT entry points
+void *FFGLExtensions::GetFramebufferProcAddress(const char *name)
+{
+  char extName[64];
+
+  if (CoreProfile)
+    return GetProcAddress(name);
+
+  if (strlen(name) + 4 > sizeof(extName))
+    throw 0;
+  strcpy(extName, name);
+  strcat(extName, "EXT");
+  return GetProcAddress(extName);
+}
+
 void FFGLExtensions::InitEXTFramebufferObject()
 {
   try
   {
 
-  glBindFramebufferEXT = (glBindFramebufferEXTPROC)GetProcAddress("glBindFramebufferEXT");
-  glBindRenderbufferEXT = (glBindRenderbufferEXTPROC)GetProcAddress("glBindRenderbufferEXT");
-  glCheckFramebufferStatusEXT = (glCheckFramebufferStatusEXTPROC)GetProcAddress("glCheckFramebufferStatusEXT");
-  glDeleteFramebuffersEXT = (glDeleteFramebuffersEXTPROC)GetProcAddress("glDeleteFramebuffersEXT");
-  glDeleteRenderBuffersEXT = (glDeleteRenderBuffersEXTPROC)GetProcAddress("glDeleteRenderbuffersEXT");
-  glFramebufferRenderbufferEXT = (glFramebufferRenderbufferEXTPROC)GetProcAddress("glFramebufferRenderbufferEXT");
-  glFramebufferTexture1DEXT = (glFramebufferTexture1DEXTPROC)GetProcAddress("glFramebufferTexture1DEXT");
-  glFramebufferTexture2DEXT = (glFramebufferTexture2DEXTPROC)GetProcAddress("glFramebufferTexture2DEXT");
-  glFramebufferTexture3DEXT = (glFramebufferTexture3DEXTPROC)GetProcAddress("glFramebufferTexture3DEXT");
-  glGenFramebuffersEXT = (glGenFramebuffersEXTPROC)GetProcAddress("glGenFramebuffersEXT");
-  glGenRenderbuffersEXT = (glGenRenderbuffersEXTPROC)GetProcAddress("glGenRenderbuffersEXT");
-  glGenerateMipmapEXT = (glGenerateMipmapEXTPROC)GetProcAddress("glGenerateMipmapEXT");
-  glGetFramebufferAttachmentParameterivEXT = (glGetFramebufferAttachmentParameterivEXTPROC)GetProcAddress("glGetFramebufferAttachmentParameterivEXT");
-  glGetRenderbufferParameterivEXT = (glGetRenderbufferParameterivEXTPROC)GetProcAddress("glGetRenderbufferParameterivEXT");
-  glIsFramebufferEXT = (glIsFramebufferEXTPROC)GetProcAddress("glIsFramebufferEXT");
-  glIsRenderbufferEXT = (glIsRenderbufferEXTPROC)GetProcAddress("glIsRenderbufferEXT");
-  glRenderbufferStorageEXT = (glRenderbufferStorageEXTPROC)GetProcAddress("glRenderbufferStorageEXT");
+  glBindFramebufferEXT = (glBindFramebufferEXTPROC)GetFramebufferProcAddress("glBindFramebuffer");
+  glBindRenderbufferEXT = (glBindRenderbufferEXTPROC)GetFramebufferProcAddress("glBindRenderbuffer");
+  glCheckFramebufferStatusEXT = (glCheckFramebufferStatusEXTPROC)GetFramebufferProcAddress("glCheckFramebufferStatus");
+  glDeleteFramebuffersEXT = (glDeleteFramebuffersEXTPROC)GetFramebufferProcAddress("glDeleteFramebuffers");
+  glDeleteRenderBuffersEXT = (glDeleteRenderBuffersEXTPROC)GetFramebufferProcAddress("glDeleteRenderbuffers");
+  glFramebufferRenderbufferEXT = (glFramebufferRenderbufferEXTPROC)GetFramebufferProcAddress("glFramebufferRenderbuffer");
+  glFramebufferTexture1DEXT = (glFramebufferTexture1DEXTPROC)GetFramebufferProcAddress("glFramebufferTexture1D");
+  glFramebufferTexture2DEXT = (glFramebufferTexture2DEXTPROC)GetFramebufferProcAddress("glFramebufferTexture2D");
+  glFramebufferTexture3DEXT = (glFramebufferTexture3DEXTPROC)GetFramebufferProcAddress("glFramebufferTexture3D");
+  glGenFramebuffersEXT = (glGenFramebuffersEXTPROC)GetFramebufferProcAddress("glGenFramebuffers");
+  glGenRenderbuffersEXT = (glGenRenderbuffersEXTPROC)GetFramebufferProcAddress("glGenRenderbuffers");
+  glGenerateMipmapEXT = (glGenerateMipmapEXTPROC)GetFramebufferProcAddress("glGenerateMipmap");
+  glGetFramebufferAttachmentParameterivEXT = (glGetFramebufferAttachmentParameterivEXTPROC)GetFramebufferProcAddress("glGetFramebufferAttachmentParameteriv");
+  glGetRenderbufferParameterivEXT = (glGetRenderbufferParameterivEXTPROC)GetFramebufferProcAddress("glGetRenderbufferParameteriv");
+  glIsFramebufferEXT = (glIsFramebufferEXTPROC)GetFramebufferProcAddress("glIsFramebuffer");
+  glIsRenderbufferEXT = (glIsRenderbufferEXTPROC)GetFramebufferProcAddress("glIsRenderbuffer");
+  glRenderbufferStorageEXT = (glRenderbufferStorageEXTPROC)GetFramebufferProcAddress("glRenderbufferStorage");
 
   }
   catch (...)
@@ -232,6 +295,24 @@ void FFGLExtensions::InitEXTFramebufferObject()
   EXT_framebuffer_object = 1;
 }
 
+void FFGLExtensions::InitCoreProfile()
+{
+  const char *version = (const char *)glGetString(GL_VERSION);
+  const char *dot;
+  GLint profile = 0;
+
+  CoreProfile = 0;
+
+  //there are profiles from 3.2, before that the query is an error
+  if (version==NULL || (dot = strchr(version, '.'))==NULL)
+    return;
+  if (atoi(version)*10 + atoi(dot+1) < 32)
+    return;
+
+  glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &profile);
+  CoreProfile = (profile & GL_CONTEXT_CORE_PROFILE_BIT) ? 1 : 0;
+}
+
 #ifdef _WIN32
 void FFGLExtensions::InitWGLEXTSwapControl()
 {
@@ -363,6 +363,9 @@ public:
   FFGLExtensions();
   
   void Initialize();
+
+  //whether the current context has an extension, in a core profile too
+  static int HasExtension(const char *name);
   
   //Multitexture
   int multitexture;
@@ -443,7 +446,7 @@ public:
   glGetUniformivARBPROC glGetUniformivARB;
   glGetShaderSourceARBPROC glGetShaderSourceARB;
 
-  //EXT_framebuffer_object
+  //EXT_framebuffer_object, or the same calls in core on a core profile context
   int EXT_framebuffer_object;
   glBindFramebufferEXTPROC glBindFramebufferEXT;
   glBindRenderbufferEXTPROC glBindRenderbufferEXT;
@@ -463,6 +466,9 @@ public:
   glIsRenderbufferEXTPROC glIsRenderbufferEXT;
   glRenderbufferStorageEXTPROC glRenderbufferStorageEXT;
 
+  //core profile context, which has no fixed function pipeline or legacy GLSL
+  int CoreProfile;
+
 #ifdef _WIN32
   int WGL_EXT_swap_control;
   wglSwapIntervalEXTPROC wglSwapIntervalEXT;
@@ -471,10 +477,12 @@ public:
 
 private:
   void *GetProcAddress(const char *);
+  void *GetFramebufferProcAddress(const char *);
   
   void InitMultitexture();
   void InitARBShaderObjects();
   void InitEXTFramebufferObject();
+  void InitCoreProfile();
 
 #ifdef _WIN32  
   void InitWGLEXTSwapControl();
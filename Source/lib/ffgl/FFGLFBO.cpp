@@ -14,8 +14,34 @@ FFGLFBO::FFGLFBO():
 
 }
 
-int FFGLFBO::Create(int _width, int _height)
+int FFGLFBO::Create(int _width, int _height, GLenum pixelFormat, int depth)
 {
+	GLuint pformat;
+	GLuint ptype;
+
+	//the pixel format and type only matter for the
+	//initial data, which there is none of
+	switch (pixelFormat)
+	{
+		case GL_RGBA8:
+			pformat = GL_RGBA;
+			ptype = GL_UNSIGNED_BYTE;
+			break;
+
+		case GL_RGBA16F:
+			pformat = GL_RGBA;
+			ptype = GL_HALF_FLOAT;
+			break;
+
+		case GL_R11F_G11F_B10F:
+			pformat = GL_RGB;
+			ptype = GL_UNSIGNED_INT_10F_11F_11F_REV;
+			break;
+
+		default:
+			return 0;
+	}
+
 	/*
 	int glWidth = 1;
 	while (glWidth<_width) glWidth*=2;
@@ -23,138 +49,83 @@ int FFGLFBO::Create(int _width, int _height)
 	int glHeight = 1;
 	while (glHeight<_height) glHeight*=2;
 	*/
-	m_glWidth = _width;
-	m_glHeight = _height;
-
 	m_width = _width;
 	m_height = _height;
 	m_glWidth = _width;
 	m_glHeight = _height;
-	m_glPixelFormat = GL_RGBA8;
+	m_glPixelFormat = pixelFormat;
 	m_glTextureTarget = GL_TEXTURE_2D;
 	m_glTextureHandle = 0;
+	m_depthBufferHandle = 0;
 	glGenFramebuffers(1, &m_fboHandle);
 
-	return 1;
-}
-
-int IsTextureResident(GLuint handle)
-{
-	GLboolean b;
-	if (glAreTexturesResident(1, &handle, &b))  
-		return 1;
-	return 0;
-}
-
-
-int FFGLFBO::BindAsRenderTarget()
-{
 	//make our fbo active
 	glBindFramebuffer(GL_FRAMEBUFFER, m_fboHandle);
 
-	//make sure there's a valid depth buffer attached to it
-	if (glIsRenderbufferEXT(m_depthBufferHandle)==0)
+	//a depth buffer only if it is asked for, passes that
+	//draw a fullscreen triangle do not need one
+	if (depth)
 	{
-		glGenRenderbuffersEXT(1, &m_depthBufferHandle);
-		glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, m_depthBufferHandle);
-		glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT24, m_glWidth, m_glHeight);
+		glGenRenderbuffers(1, &m_depthBufferHandle);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_depthBufferHandle);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_glWidth, m_glHeight);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
 		//attach our depth buffer to the fbo
-		glFramebufferRenderbufferEXT(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER_EXT, m_depthBufferHandle);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBufferHandle);
 	}
 
-	//make sure we have a valid gl texture attached to it
-	if (!IsTextureResident(m_glTextureHandle))
-	{
-		//get a new one
-		glGenTextures(1,&m_glTextureHandle);
-
-		//bind it for some initialization
-		glBindTexture(m_glTextureTarget, m_glTextureHandle);
-
-		//this only works if the FBO pixel format
-		//is GL_RGBA8. other FBO pixel formats have to
-		//define their texture differently
-		GLuint pformat = GL_RGBA;
-		GLuint ptype = GL_UNSIGNED_BYTE;
-
-		glTexImage2D(
-			m_glTextureTarget,	//texture target
-			0,					//mipmap level
-			m_glPixelFormat,	//gl internal pixel format
-			m_glWidth,			//gl width
-			m_glHeight,			//gl height
-			0,					//no border
-			pformat,			//pixel format #2
-			ptype,				//pixel type
-			NULL);				//null texture image data pointer
-
-		//for now, do not do mipmapping.
-		//to do mipmapping, set this to 1, and after we've bound the texture,
-		//we would need to call glGenerateMipmap(m_textureTarget) to make sure
-		//the mipmaps have been updated
-		int do_mipmaps = 0;
-
-		if (do_mipmaps)
-			glGenerateMipmap(m_glTextureTarget);
-
-		glTexParameteri(m_glTextureTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		if (do_mipmaps)
-			glTexParameteri(m_glTextureTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		else
-			glTexParameteri(m_glTextureTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-		glTexParameteri(m_glTextureTarget, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(m_glTextureTarget, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-		//unbind the texture
-		glBindTexture(m_glTextureTarget, 0);
-
-		//attach our texture to the FBO
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_glTextureTarget, m_glTextureHandle, 0);
-	}  
+	glGenTextures(1,&m_glTextureHandle);
 
-	GLenum status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+	//bind it for some initialization
+	glBindTexture(m_glTextureTarget, m_glTextureHandle);
 
-	switch(status)
-	{
-		case GL_FRAMEBUFFER_COMPLETE:
-			//no error
-			break;
+	glTexImage2D(
+		m_glTextureTarget,	//texture target
+		0,					//mipmap level
+		m_glPixelFormat,	//gl internal pixel format
+		m_glWidth,			//gl width
+		m_glHeight,			//gl height
+		0,					//no border
+		pformat,			//pixel format #2
+		ptype,				//pixel type
+		NULL);				//null texture image data pointer
 
-		case GL_FRAMEBUFFER_UNSUPPORTED:
-			//FFDebugMessage("GL_FRAMEBUFFER_UNSUPPORTED");
-			return 0;
+	//no mipmaps, they would have to be generated after every render
+	glTexParameteri(m_glTextureTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(m_glTextureTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(m_glTextureTarget, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(m_glTextureTarget, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-		case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT:
-			//FFDebugMessage("GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT");
-			return 0;
+	//unbind the texture
+	glBindTexture(m_glTextureTarget, 0);
 
-		case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT:
-			//FFDebugMessage("GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT");
-			return 0;
+	//attach our texture to the FBO
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_glTextureTarget, m_glTextureHandle, 0);
 
-		case GL_FRAMEBUFFER_INCOMPLETE_DIMENSIONS_EXT:
-			//FFDebugMessage("GL_FRAMEBUFFER_INCOMPLETE_DIMENSIONS_EXT");
-			return 0;
+	//checked once here instead of on every bind
+	GLenum status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
 
-		case GL_FRAMEBUFFER_INCOMPLETE_FORMATS_EXT:
-			//FFDebugMessage("GL_FRAMEBUFFER_INCOMPLETE_FORMATS_EXT");
-			return 0;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-		case GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER:
-			//FFDebugMessage("GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER");
-			return 0;
+	if (status!=GL_FRAMEBUFFER_COMPLETE)
+	{
+		//GL_FRAMEBUFFER_UNSUPPORTED is the usual one, for a float
+		//format the driver cannot render to
+		FreeResources();
+		return 0;
+	}
 
-		case GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER:
-			//FFDebugMessage("GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER");
-			return 0;
+	return 1;
+}
 
-		default:
-			//FFDebugMessage("Unknown GL_FRAMEBUFFER error");
-			return 0;		
-	}
+int FFGLFBO::BindAsRenderTarget()
+{
+	if (m_fboHandle==0)
+		return 0;
+
+	//make our fbo active
+	glBindFramebuffer(GL_FRAMEBUFFER, m_fboHandle);
 
 	return 1;
 }
@@ -180,6 +151,22 @@ FFGLTextureStruct FFGLFBO::GetTextureInfo()
 	return t;
 }
 
+GLuint64 FFGLFBO::GetMemorySize()
+{
+	return GetMemorySize(m_glWidth, m_glHeight, m_glPixelFormat, HasDepth());
+}
+
+GLuint64 FFGLFBO::GetMemorySize(int width, int height, GLenum pixelFormat, int depth)
+{
+	GLuint64 bytesPerPixel = (pixelFormat==GL_RGBA16F) ? 8 : 4;
+
+	//GL_DEPTH_COMPONENT24 is padded to 32 bits
+	if (depth)
+		bytesPerPixel += 4;
+
+	return (GLuint64)width*height*bytesPerPixel;
+}
+
 
 void FFGLFBO::FreeResources()
 {
@@ -191,7 +178,7 @@ void FFGLFBO::FreeResources()
 
 	if (m_depthBufferHandle)
 	{
-		glDeleteRenderbuffersEXT(1, &m_depthBufferHandle);
+		glDeleteRenderbuffers(1, &m_depthBufferHandle);
 		m_depthBufferHandle = 0;
 	}
 
@@ -10,7 +10,10 @@ public:
 	FFGLFBO();
 
 
-	int Create(int width, int height);
+	//pixelFormat is GL_RGBA8, GL_RGBA16F or GL_R11F_G11F_B10F.
+	//the texture and the optional depth buffer are made here, so
+	//binding does not need to check them
+	int Create(int width, int height, GLenum pixelFormat = GL_RGBA8, int depth = 1);
 	int BindAsRenderTarget();
 	int UnbindAsRenderTarget(GLuint hostFbo);
 
@@ -20,6 +23,13 @@ public:
 	GLuint GetWidth() { return m_width; }
 	GLuint GetHeight() { return m_height; }
 	GLuint GetFBOHandle() { return m_fboHandle; }
+	GLuint GetTextureHandle() { return m_glTextureHandle; }
+	GLenum GetPixelFormat() { return m_glPixelFormat; }
+	int HasDepth() { return m_depthBufferHandle!=0; }
+
+	//approximate video memory used by the texture and depth buffer
+	GLuint64 GetMemorySize();
+	static GLuint64 GetMemorySize(int width, int height, GLenum pixelFormat, int depth);
 
 protected:
 	GLuint m_width;
@@ -0,0 +1,116 @@
+#include "FFGLFBOPool.h"
+
+FFGLFBOPool::FFGLFBOPool(unsigned int budgetMB) :
+	m_budget((GLuint64)budgetMB*1024*1024),
+	m_memory(0),
+	m_useCount(0)
+{
+}
+
+FFGLFBOPool::~FFGLFBOPool()
+{
+	//the context has gone by now, so the driver releases the fbos
+	for (size_t i = 0; i < m_fbos.size(); i++)
+		delete m_fbos[i].fbo;
+	m_fbos.clear();
+}
+
+void FFGLFBOPool::SetBudget(unsigned int budgetMB)
+{
+	m_budget = (GLuint64)budgetMB*1024*1024;
+	Trim(0);
+}
+
+GLuint64 FFGLFBOPool::GetBudget()
+{
+	return m_budget;
+}
+
+GLuint64 FFGLFBOPool::GetMemoryUsed()
+{
+	return m_memory;
+}
+
+FFGLFBO *FFGLFBOPool::Acquire(int width, int height, GLenum pixelFormat, int depth)
+{
+	FFGLFBOPoolEntry entry;
+
+	for (size_t i = 0; i < m_fbos.size(); i++)
+	{
+		FFGLFBO *fbo = m_fbos[i].fbo;
+		if (!m_fbos[i].inUse &&
+			fbo->GetWidth()==(GLuint)width && fbo->GetHeight()==(GLuint)height &&
+			fbo->GetPixelFormat()==pixelFormat && fbo->HasDepth()==(depth ? 1 : 0))
+		{
+			m_fbos[i].inUse = 1;
+			return fbo;
+		}
+	}
+
+	//make room for it first so the budget is never exceeded
+	entry.fbo = new FFGLFBO;
+	entry.size = FFGLFBO::GetMemorySize(width, height, pixelFormat, depth);
+	Trim(entry.size);
+
+	if (m_memory + entry.size > m_budget || !entry.fbo->Create(width, height, pixelFormat, depth))
+	{
+		delete entry.fbo;
+		return NULL;
+	}
+
+	entry.inUse = 1;
+	entry.lastUsed = m_useCount;
+	m_memory += entry.size;
+	m_fbos.push_back(entry);
+
+	return entry.fbo;
+}
+
+void FFGLFBOPool::Release(FFGLFBO *fbo)
+{
+	for (size_t i = 0; i < m_fbos.size(); i++)
+	{
+		if (m_fbos[i].fbo==fbo)
+		{
+			m_fbos[i].inUse = 0;
+			m_fbos[i].lastUsed = ++m_useCount;
+			break;
+		}
+	}
+
+	//the budget may have been lowered while it was in use
+	Trim(0);
+}
+
+void FFGLFBOPool::Clear()
+{
+	for (size_t i = 0; i < m_fbos.size(); i++)
+	{
+		m_fbos[i].fbo->FreeResources();
+		delete m_fbos[i].fbo;
+	}
+	m_fbos.clear();
+	m_memory = 0;
+}
+
+//delete free fbos, least recently used first, until there is room for needed bytes
+void FFGLFBOPool::Trim(GLuint64 needed)
+{
+	while (m_memory + needed > m_budget)
+	{
+		size_t oldest = m_fbos.size();
+		for (size_t i = 0; i < m_fbos.size(); i++)
+		{
+			if (!m_fbos[i].inUse && (oldest==m_fbos.size() || m_fbos[i].lastUsed < m_fbos[oldest].lastUsed))
+				oldest = i;
+		}
+
+		if (oldest==m_fbos.size())
+			return; //everything left is in use
+
+		m_memory -= m_fbos[oldest].size;
+		m_fbos[oldest].fbo->FreeResources();
+		delete m_fbos[oldest].fbo;
+		m_fbos.erase(m_fbos.begin() + oldest);
+	}
+}
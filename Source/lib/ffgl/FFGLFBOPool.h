@@ -0,0 +1,49 @@
+#ifndef FFGLFBOPool_H
+#define FFGLFBOPool_H
+
+#include <FFGL.h>
+#include <FFGLFBO.h>
+#include <vector>
+
+//Render targets shared by every plugin instance on a context.
+//
+//A released fbo is kept and handed out again for the same size, pixel
+//format and depth, so intermediate passes do not allocate for each clip.
+//The textures of all the fbos together are kept under a memory budget.
+//When a new fbo would go over it, free ones are deleted least recently
+//used first, and if that is not enough Acquire fails.
+class FFGLFBOPool
+{
+public:
+	FFGLFBOPool(unsigned int budgetMB);
+	virtual ~FFGLFBOPool();
+
+	void SetBudget(unsigned int budgetMB);
+	GLuint64 GetBudget();
+	GLuint64 GetMemoryUsed();
+
+	//creating an fbo changes the fbo and texture bindings
+	FFGLFBO *Acquire(int width, int height, GLenum pixelFormat, int depth);
+	void Release(FFGLFBO *fbo);
+
+	//delete every fbo, which needs the context
+	void Clear();
+
+private:
+	struct FFGLFBOPoolEntry
+	{
+		FFGLFBO *fbo;
+		GLuint64 size;
+		int inUse;
+		unsigned int lastUsed;
+	};
+
+	std::vector<FFGLFBOPoolEntry> m_fbos;
+	GLuint64 m_budget;
+	GLuint64 m_memory;
+	unsigned int m_useCount; //orders the free fbos by when they were released
+
+	void Trim(GLuint64 needed);
+};
+
+#endif
@@ -0,0 +1,278 @@
+#include "FFGLProgramCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/utime.h>
+#include <algorithm>
+
+#define PROGRAMCACHE_MAGIC   0x42504646 // "FFPB"
+#define PROGRAMCACHE_VERSION 1
+
+//file header, followed by the binary and then the uniforms
+//as a location, a name length and the name
+struct FFGLProgramCacheHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	GLuint64 key;
+	GLenum binaryFormat;
+	GLint binaryLength;
+	unsigned int numUniforms;
+};
+
+struct FFGLProgramCacheFile
+{
+	std::string name;
+	GLuint64 size;
+	unsigned __int64 lastUsed;
+};
+
+static bool OlderFile(const FFGLProgramCacheFile &a, const FFGLProgramCacheFile &b)
+{
+	return a.lastUsed < b.lastUsed;
+}
+
+//64 bit FNV-1a
+static GLuint64 HashString(GLuint64 hash, const char *text)
+{
+	if (text==NULL)
+		text = "";
+
+	//include the terminator so that "ab"+"c" differs from "a"+"bc"
+	do
+	{
+		hash ^= (unsigned char)*text;
+		hash *= 1099511628211ULL;
+	} while (*text++);
+
+	return hash;
+}
+
+FFGLProgramCache::FFGLProgramCache() :
+	m_maxSize(0),
+	m_enabled(0)
+{
+}
+
+FFGLProgramCache::~FFGLProgramCache()
+{
+}
+
+int FFGLProgramCache::Initialize(const char *folder, const char *pluginVersion, unsigned int maxSizeMB)
+{
+	GLint numFormats = 0;
+	DWORD attributes;
+
+	m_enabled = 0;
+
+	//some drivers expose the extension with no binary formats at all
+	if (!GLEE_ARB_get_program_binary)
+		return 0;
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+	if (numFormats <= 0)
+		return 0;
+
+	attributes = GetFileAttributesA(folder);
+	if (attributes==INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY))
+		return 0;
+
+	m_folder = folder;
+	m_maxSize = (GLuint64)maxSizeMB*1024*1024;
+
+	m_salt  = (const char *)glGetString(GL_RENDERER);
+	m_salt += "\n";
+	m_salt += (const char *)glGetString(GL_VERSION);
+	m_salt += "\n";
+	m_salt += pluginVersion;
+
+	m_enabled = 1;
+
+	return 1;
+}
+
+int FFGLProgramCache::IsEnabled()
+{
+	return m_enabled;
+}
+
+//the source key from FFGLShader::HashSource combined with the renderer and versions
+GLuint64 FFGLProgramCache::GetKey(GLuint64 sourceKey)
+{
+	char text[32];
+
+	sprintf_s(text, 32, "%016llx", sourceKey);
+
+	return HashString(HashString(14695981039346656037ULL, text), m_salt.c_str());
+}
+
+std::string FFGLProgramCache::GetFilePath(GLuint64 key)
+{
+	char filename[32];
+	sprintf_s(filename, 32, "\\%016llx.bin", key);
+	return m_folder + filename;
+}
+
+int FFGLProgramCache::Load(GLuint64 key, GLuint glProgram, std::vector<FFGLCachedUniform> &uniforms)
+{
+	FFGLProgramCacheHeader header;
+	std::vector<char> binary;
+	FILE *file = NULL;
+	GLint linkStatus = 0;
+
+	uniforms.clear();
+
+	if (!m_enabled || glProgram==0)
+		return 0;
+
+	std::string path = GetFilePath(key);
+	if (fopen_s(&file, path.c_str(), "rb")!=0 || file==NULL)
+		return 0;
+
+	int success = (fread(&header, sizeof(header), 1, file)==1 &&
+				   header.magic==PROGRAMCACHE_MAGIC &&
+				   header.version==PROGRAMCACHE_VERSION &&
+				   header.key==key &&
+				   header.binaryLength > 0);
+
+	if (success)
+	{
+		binary.resize(header.binaryLength);
+		success = (fread(&binary[0], header.binaryLength, 1, file)==1);
+	}
+
+	for (unsigned int i = 0; success && i < header.numUniforms; i++)
+	{
+		FFGLCachedUniform uniform;
+		unsigned short length = 0;
+		char name[256];
+
+		success = (fread(&uniform.location, sizeof(GLint), 1, file)==1 &&
+				   fread(&length, sizeof(length), 1, file)==1 &&
+				   length < sizeof(name) &&
+				   fread(name, length, 1, file)==1);
+		if (success)
+		{
+			name[length] = 0;
+			uniform.name = name;
+			uniforms.push_back(uniform);
+		}
+	}
+
+	fclose(file);
+
+	if (success)
+	{
+		glProgramBinary(glProgram, header.binaryFormat, &binary[0], header.binaryLength);
+		glGetProgramiv(glProgram, GL_LINK_STATUS, &linkStatus);
+		success = (linkStatus==GL_TRUE);
+	}
+
+	if (!success)
+	{
+		//the driver can reject a binary for any reason, so just compile again
+		uniforms.clear();
+		remove(path.c_str());
+		return 0;
+	}
+
+	//mark it as recently used
+	_utime(path.c_str(), NULL);
+
+	return 1;
+}
+
+int FFGLProgramCache::Save(GLuint64 key, GLuint glProgram, const std::vector<FFGLCachedUniform> &uniforms)
+{
+	FFGLProgramCacheHeader header;
+	std::vector<char> binary;
+	FILE *file = NULL;
+	GLint binaryLength = 0;
+	GLenum binaryFormat = 0;
+
+	if (!m_enabled || glProgram==0)
+		return 0;
+
+	glGetProgramiv(glProgram, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if (binaryLength <= 0)
+		return 0;
+
+	binary.resize(binaryLength);
+	glGetProgramBinary(glProgram, binaryLength, &binaryLength, &binaryFormat, &binary[0]);
+	if (binaryLength <= 0)
+		return 0;
+
+	memset(&header, 0, sizeof(header));
+	header.magic        = PROGRAMCACHE_MAGIC;
+	header.version      = PROGRAMCACHE_VERSION;
+	header.key          = key;
+	header.binaryFormat = binaryFormat;
+	header.binaryLength = binaryLength;
+	header.numUniforms  = (unsigned int)uniforms.size();
+
+	//write to a temporary file and rename it so that another
+	//process never reads a file that is only partly written
+	std::string path = GetFilePath(key);
+	std::string tempPath = path + ".tmp";
+	if (fopen_s(&file, tempPath.c_str(), "wb")!=0 || file==NULL)
+		return 0;
+
+	int success = (fwrite(&header, sizeof(header), 1, file)==1 &&
+				   fwrite(&binary[0], binaryLength, 1, file)==1);
+
+	for (size_t i = 0; success && i < uniforms.size(); i++)
+	{
+		size_t nameLength = uniforms[i].name.size();
+		unsigned short length = (unsigned short)(nameLength < 255 ? nameLength : 255);
+		success = (fwrite(&uniforms[i].location, sizeof(GLint), 1, file)==1 &&
+				   fwrite(&length, sizeof(length), 1, file)==1 &&
+				   fwrite(uniforms[i].name.c_str(), length, 1, file)==1);
+	}
+
+	fclose(file);
+
+	if (!success || !MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		remove(tempPath.c_str());
+		return 0;
+	}
+
+	Trim();
+
+	return 1;
+}
+
+//delete the least recently used binaries until the folder is under the size limit
+void FFGLProgramCache::Trim()
+{
+	std::vector<FFGLProgramCacheFile> files;
+	WIN32_FIND_DATAA fd;
+	HANDLE hFind;
+	GLuint64 total = 0;
+
+	hFind = FindFirstFileA((m_folder + "\\*.bin").c_str(), &fd);
+	if (hFind==INVALID_HANDLE_VALUE)
+		return;
+
+	do
+	{
+		FFGLProgramCacheFile cacheFile;
+		cacheFile.name     = fd.cFileName;
+		cacheFile.size     = ((GLuint64)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+		cacheFile.lastUsed = ((unsigned __int64)fd.ftLastWriteTime.dwHighDateTime << 32) | fd.ftLastWriteTime.dwLowDateTime;
+		total += cacheFile.size;
+		files.push_back(cacheFile);
+	} while (FindNextFileA(hFind, &fd));
+
+	FindClose(hFind);
+
+	if (total <= m_maxSize)
+		return;
+
+	std::sort(files.begin(), files.end(), OlderFile);
+
+	for (size_t i = 0; i < files.size() && total > m_maxSize; i++)
+	{
+		if (remove((m_folder + "\\" + files[i].name).c_str())==0)
+			total -= files[i].size;
+	}
+}
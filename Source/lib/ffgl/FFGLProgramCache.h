@@ -0,0 +1,45 @@
+#ifndef FFGLProgramCache_H
+#define FFGLProgramCache_H
+
+#include <FFGL.h>
+#include <string>
+#include <vector>
+
+//a uniform location looked up on a program, stored with its binary
+struct FFGLCachedUniform
+{
+	std::string name;
+	GLint location;
+};
+
+//On-disk cache of linked program binaries (ARB_get_program_binary).
+//
+//Programs are keyed on a hash of the vertex and fragment source together with
+//GL_RENDERER, GL_VERSION and the plugin version, so a driver or plugin update
+//never picks up an old binary. The uniform locations found on the program are
+//stored in the same file. The folder is kept under a size limit by deleting the
+//least recently used files first.
+class FFGLProgramCache
+{
+public:
+	FFGLProgramCache();
+	virtual ~FFGLProgramCache();
+
+	int Initialize(const char *folder, const char *pluginVersion, unsigned int maxSizeMB);
+	int IsEnabled();
+
+	GLuint64 GetKey(GLuint64 sourceKey);
+	int Load(GLuint64 key, GLuint glProgram, std::vector<FFGLCachedUniform> &uniforms);
+	int Save(GLuint64 key, GLuint glProgram, const std::vector<FFGLCachedUniform> &uniforms);
+
+private:
+	std::string m_folder;
+	std::string m_salt;
+	GLuint64 m_maxSize;
+	int m_enabled;
+
+	std::string GetFilePath(GLuint64 key);
+	void Trim();
+};
+
+#endif
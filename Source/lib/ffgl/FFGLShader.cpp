@@ -1,13 +1,40 @@
 #include "FFGLShader.h"
+#include "FFGLExtensions.h"
 #include <stdio.h>
+#include <string.h>
 
 #define LOGSHADERERRORS
 
+//KHR_parallel_shader_compile (and the ARB version) are not in GLee
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+
+//check the extensions once for parallel shader compile
+static int ParallelShaderCompile()
+{
+	static int supported = -1;
+
+	if (supported < 0)
+	{
+		supported = (FFGLExtensions::HasExtension("GL_KHR_parallel_shader_compile") ||
+					 FFGLExtensions::HasExtension("GL_ARB_parallel_shader_compile")) ? 1 : 0;
+	}
+
+	return supported;
+}
+
 FFGLShader::FFGLShader() :
 	m_linkStatus(0),
+	m_compilePending(0),
+	m_programCache(NULL),
+	m_cacheKey(0),
+	m_sourceKey(0),
+	m_cached(0),
+	m_uploaded(0),
+	m_skipped(0),
 	m_glProgram(0),
 	m_glVertexShader(0),
-	m_glFragmentShader(0)
+	m_glFragmentShader(0),
+	m_glSharedVertexShader(0)
 
 {
 }
@@ -18,7 +45,12 @@ void FFGLShader::CreateGLResources()
 		m_glProgram = glCreateProgram();
 
 	if (m_glVertexShader==0)
-		m_glVertexShader = glCreateShader(GL_VERTEX_SHADER_ARB);
+	{
+		if (m_glSharedVertexShader!=0)
+			m_glVertexShader = m_glSharedVertexShader;
+		else
+			m_glVertexShader = glCreateShader(GL_VERTEX_SHADER_ARB);
+	}
 
 	if (m_glFragmentShader==0)
 		m_glFragmentShader = glCreateShader(GL_FRAGMENT_SHADER_ARB);
@@ -34,7 +66,9 @@ void FFGLShader::FreeGLResources()
 
 	if (m_glVertexShader)
 	{
-		glDeleteShader(m_glVertexShader);
+		//a shared vertex shader belongs to the caller
+		if (m_glVertexShader!=m_glSharedVertexShader)
+			glDeleteShader(m_glVertexShader);
 		m_glVertexShader = 0;
 	}
 
@@ -43,6 +77,13 @@ void FFGLShader::FreeGLResources()
 		glDeleteProgram(m_glProgram);
 		m_glProgram = 0;
 	}
+
+	m_linkStatus = 0;
+	m_compilePending = 0;
+	m_cached = 0;
+	m_sourceKey = 0;
+	m_uniforms.clear();
+	m_shadow.clear();
 }
 
 int FFGLShader::BindShader()
@@ -78,58 +119,78 @@ int FFGLShader::Compile(const std::string& vtxProgram, const std::string& fragPr
 }
 
 int FFGLShader::Compile(const char *vtxProgram, const char *fragProgram)
+{
+	if (!BeginCompile(vtxProgram, fragProgram))
+		return 0;
+
+	return EndCompile();
+}
+
+int FFGLShader::BeginCompile(const char *vtxProgram, const char *fragProgram)
+{
+  const char *strings[] = { fragProgram };
+
+  if (fragProgram==NULL || fragProgram[0]==0)
+	  return BeginCompile(vtxProgram, 0, NULL, NULL);
+
+  return BeginCompile(vtxProgram, 1, strings, NULL);
+}
+
+//source, compile and link without asking for any status so that
+//the driver is free to do the work in the background
+int FFGLShader::BeginCompile(const char *vtxProgram, int fragCount, const char **fragStrings, const GLint *fragLengths)
 {
   if (m_glProgram==0)
 	  CreateGLResources();
-  
+
   int doLink = 0;
 
+  m_linkStatus = 0;
+  m_compilePending = 0;
+  m_cached = 0;
+  m_uniforms.clear();
+  m_shadow.clear();
+  m_sourceKey = HashSource(vtxProgram, fragCount, fragStrings, fragLengths);
+
+  //a cached binary of the same source needs no compile at all
+  if (m_programCache!=NULL && m_programCache->IsEnabled() && m_glProgram!=0)
+  {
+	  m_cacheKey = m_programCache->GetKey(m_sourceKey);
+	  if (m_programCache->Load(m_cacheKey, m_glProgram, m_uniforms))
+	  {
+		  m_linkStatus = 1;
+		  m_cached = 1;
+		  return 1;
+	  }
+
+	  //ask for a binary that can be saved after the link
+	  glProgramParameteri(m_glProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+
   //if we can compile a fragment shader, do it.
   if (m_glFragmentShader !=0 &&
       m_glProgram !=0 &&
-      fragProgram != NULL &&
-	  fragProgram[0] !=0)
+      fragCount > 0 &&
+	  fragStrings != NULL)
   {
-    const char *strings[] =
-    {
-      fragProgram,
-      NULL
-    };
-
     // Load Shader Sources
-    glShaderSource(m_glFragmentShader, 1, strings, NULL);
+    glShaderSource(m_glFragmentShader, fragCount, fragStrings, fragLengths);
 
     // Compile The Shaders
     glCompileShader(m_glFragmentShader);
-    
-    GLint compileSuccess;
-    glGetShaderiv(m_glFragmentShader, GL_COMPILE_STATUS, &compileSuccess);
-
-    if (compileSuccess == GL_TRUE)
-    {
-		//attach it to the program
-		glAttachShader(m_glProgram, m_glFragmentShader);
-		doLink = 1;
-    }
-    else
-    {
-		//get the log so we can peek at the error string
-		char log[1024];
-		GLsizei returnedLength;
-
-		glGetProgramInfoLog(m_glFragmentShader, sizeof(log)-1, &returnedLength, log);
-		log[returnedLength] = 0;
-
-		#ifdef LOGSHADERERRORS
-		printf( "Fragment Shader error: %s \n", log );
-		#endif
-		int a;
-		a=0;
-    }
+
+    AttachShader(m_glFragmentShader);
+    doLink = 1;
   }
 
+	//a shared vertex shader is already compiled
+	if (m_glVertexShader!=0 && m_glProgram!=0 && m_glVertexShader==m_glSharedVertexShader)
+	{
+		AttachShader(m_glVertexShader);
+		doLink = 1;
+	}
 	//if we can compile a vertex shader, do it
-	if (m_glVertexShader!=0 && m_glProgram!=0 && vtxProgram!=0 && vtxProgram[0]!=0)
+	else if (m_glVertexShader!=0 && m_glProgram!=0 && vtxProgram!=0 && vtxProgram[0]!=0)
 	{
 		const char *strings[] =
 		{
@@ -143,46 +204,454 @@ int FFGLShader::Compile(const char *vtxProgram, const char *fragProgram)
 		// Compile The Shaders
 		glCompileShader(m_glVertexShader);
 
-		GLint compileSuccess;
-
-		glGetShaderiv(m_glVertexShader, GL_COMPILE_STATUS, &compileSuccess);
+		AttachShader(m_glVertexShader);
+		doLink = 1;
+	}
 
-		if (compileSuccess == GL_TRUE)
-		{
-			//attach it to the program
-			glAttachShader(m_glProgram, m_glVertexShader);
-			doLink = 1;
-		} 
-		else
-		{
-			//get the log so we can peek at the error string
-			char log[1024];
-			GLsizei returnedLength;
-			glGetProgramInfoLog(m_glVertexShader, sizeof(log)-1, &returnedLength, log);
-			log[returnedLength] = 0;
-			int a;
-			a=0;
-
-			#ifdef LOGSHADERERRORS
-			printf( "Vertex Shader error: %s \n", log );
-			#endif
-		}     
-	}
-  
-  //check if linking worked
-  GLint linkSuccess = 0;
   if (doLink)
   {
+	  //attribute bindings only take effect at the link
+	  for (size_t i = 0; i < m_attribLocations.size(); i++)
+		  glBindAttribLocation(m_glProgram, m_attribLocations[i].first, m_attribLocations[i].second.c_str());
+
 	  // Link The Program Object
 	  glLinkProgram(m_glProgram);
+	  m_compilePending = 1;
+  }
+
+  return doLink;
+}
+
+int FFGLShader::IsCompileComplete()
+{
+	if (!m_compilePending)
+		return 1;
+
+	//with parallel compile the driver can tell us if it has finished
+	//without waiting for it
+	if (ParallelShaderCompile())
+	{
+		GLint complete = 0;
+		glGetProgramiv(m_glProgram, GL_COMPLETION_STATUS_KHR, &complete);
+		return (complete == GL_TRUE);
+	}
+
+	//otherwise the status queries in EndCompile will wait for it,
+	//but it has had the time since BeginCompile to work on it
+	return 1;
+}
+
+int FFGLShader::EndCompile()
+{
+  GLint linkSuccess = 0;
+
+  if (m_compilePending)
+  {
+	  m_compilePending = 0;
+
+	  int compileSuccess = CheckCompileStatus(m_glFragmentShader, "Fragment");
+	  compileSuccess &= CheckCompileStatus(m_glVertexShader, "Vertex");
+
+	  //check if linking worked
 	  glGetProgramiv(m_glProgram, GL_LINK_STATUS, &linkSuccess);
+
+	  #ifdef LOGSHADERERRORS
+	  if (linkSuccess != GL_TRUE && compileSuccess)
+	  {
+		  char log[1024];
+		  GLsizei returnedLength = 0;
+		  glGetProgramInfoLog(m_glProgram, sizeof(log)-1, &returnedLength, log);
+		  log[returnedLength] = 0;
+		  printf( "Shader link error: %s \n", log );
+	  }
+	  #endif
+
+	  m_linkStatus = linkSuccess;
   }
-  
-  m_linkStatus = linkSuccess;
-  return linkSuccess;
+
+  return m_linkStatus;
+}
+
+void FFGLShader::AttachShader(GLenum glShader)
+{
+	GLuint attached[2];
+	GLsizei count = 0;
+
+	//attaching twice is an error if the same object is compiled again
+	glGetAttachedShaders(m_glProgram, 2, &count, attached);
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if (attached[i] == glShader)
+			return;
+	}
+
+	glAttachShader(m_glProgram, glShader);
+}
+
+int FFGLShader::CheckCompileStatus(GLenum glShader, const char *type)
+{
+	GLint sourceLength = 0;
+	GLint compileSuccess = 0;
+
+	//not used by this program
+	glGetShaderiv(glShader, GL_SHADER_SOURCE_LENGTH, &sourceLength);
+	if (sourceLength == 0)
+		return 1;
+
+	glGetShaderiv(glShader, GL_COMPILE_STATUS, &compileSuccess);
+	if (compileSuccess == GL_TRUE)
+		return 1;
+
+	//get the log so we can peek at the error string
+	char log[1024];
+	GLsizei returnedLength = 0;
+	glGetShaderInfoLog(glShader, sizeof(log)-1, &returnedLength, log);
+	log[returnedLength] = 0;
+
+	#ifdef LOGSHADERERRORS
+	printf( "%s Shader error: %s \n", type, log );
+	#endif
+
+	return 0;
 }
 
 GLuint FFGLShader::FindUniform(const char *name)
 {
-	return glGetUniformLocation(m_glProgram,name);
+	//locations loaded with a cached program or already looked up
+	for (size_t i = 0; i < m_uniforms.size(); i++)
+	{
+		if (m_uniforms[i].name==name)
+			return m_uniforms[i].location;
+	}
+
+	FFGLCachedUniform uniform;
+	uniform.name = name;
+	uniform.location = glGetUniformLocation(m_glProgram,name);
+	m_uniforms.push_back(uniform);
+
+	return uniform.location;
+}
+
+//uniforms the compiler has not optimised out
+int FFGLShader::GetActiveUniforms(std::vector<FFGLActiveUniform> &uniforms)
+{
+	GLint count = 0;
+	GLint maxLength = 0;
+
+	uniforms.clear();
+
+	if (m_glProgram==0 || m_linkStatus!=1)
+		return 0;
+
+	glGetProgramiv(m_glProgram, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(m_glProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	if (count <= 0 || maxLength <= 0)
+		return 0;
+
+	std::vector<char> name(maxLength+1);
+
+	for (GLint i = 0; i < count; i++)
+	{
+		FFGLActiveUniform uniform;
+		GLsizei length = 0;
+
+		glGetActiveUniform(m_glProgram, i, maxLength, &length, &uniform.size, &uniform.type, &name[0]);
+		name[length] = 0;
+
+		//built in uniforms such as gl_ModelViewProjectionMatrix have no location
+		if (strncmp(&name[0], "gl_", 3)==0)
+			continue;
+
+		uniform.name = &name[0];
+		size_t bracket = uniform.name.find('[');
+		if (bracket!=std::string::npos)
+			uniform.name.erase(bracket);
+
+		uniform.location = FindUniform(uniform.name.c_str());
+		if (uniform.location < 0)
+			continue;
+
+		uniforms.push_back(uniform);
+	}
+
+	return (int)uniforms.size();
+}
+
+//returns 0 if the program has no active block with this name
+int FFGLShader::BindUniformBlock(const char *name, GLuint binding)
+{
+	if (m_glProgram==0 || m_linkStatus!=1 || !GLEE_ARB_uniform_buffer_object)
+		return 0;
+
+	GLuint index = glGetUniformBlockIndex(m_glProgram, name);
+	if (index==GL_INVALID_INDEX)
+		return 0;
+
+	glUniformBlockBinding(m_glProgram, index, binding);
+
+	return 1;
+}
+
+//compare with the last value uploaded to the location and keep the new one
+int FFGLShader::IsUniformChanged(GLint location, const void *data, GLsizei size)
+{
+	if (location < 0)
+		return 0;
+
+	//too big to keep, so always upload it
+	if (size > FFGLSHADER_MAX_SHADOW)
+	{
+		m_uploaded++;
+		return 1;
+	}
+
+	for (size_t i = 0; i < m_shadow.size(); i++)
+	{
+		if (m_shadow[i].location==location)
+		{
+			if (m_shadow[i].size==size && memcmp(m_shadow[i].data, data, size)==0)
+			{
+				m_skipped++;
+				return 0;
+			}
+			m_shadow[i].size = size;
+			memcpy(m_shadow[i].data, data, size);
+			m_uploaded++;
+			return 1;
+		}
+	}
+
+	FFGLUniformShadow shadow;
+	shadow.location = location;
+	shadow.size = size;
+	memcpy(shadow.data, data, size);
+	m_shadow.push_back(shadow);
+	m_uploaded++;
+
+	return 1;
+}
+
+void FFGLShader::SetUniform1i(GLint location, GLint value)
+{
+	if (!IsUniformChanged(location, &value, sizeof(value)))
+		return;
+
+	if (GLEE_ARB_separate_shader_objects)
+		glProgramUniform1i(m_glProgram, location, value);
+	else
+		glUniform1i(location, value);
+}
+
+void FFGLShader::SetUniform1f(GLint location, GLfloat x)
+{
+	if (!IsUniformChanged(location, &x, sizeof(x)))
+		return;
+
+	if (GLEE_ARB_separate_shader_objects)
+		glProgramUniform1f(m_glProgram, location, x);
+	else
+		glUniform1f(location, x);
+}
+
+void FFGLShader::SetUniform2f(GLint location, GLfloat x, GLfloat y)
+{
+	GLfloat values[2] = { x, y };
+
+	if (!IsUniformChanged(location, values, sizeof(values)))
+		return;
+
+	if (GLEE_ARB_separate_shader_objects)
+		glProgramUniform2f(m_glProgram, location, x, y);
+	else
+		glUniform2f(location, x, y);
+}
+
+void FFGLShader::SetUniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z)
+{
+	GLfloat values[3] = { x, y, z };
+
+	if (!IsUniformChanged(location, values, sizeof(values)))
+		return;
+
+	if (GLEE_ARB_separate_shader_objects)
+		glProgramUniform3f(m_glProgram, location, x, y, z);
+	else
+		glUniform3f(location, x, y, z);
+}
+
+void FFGLShader::SetUniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+	GLfloat values[4] = { x, y, z, w };
+
+	if (!IsUniformChanged(location, values, sizeof(values)))
+		return;
+
+	if (GLEE_ARB_separate_shader_objects)
+		glProgramUniform4f(m_glProgram, location, x, y, z, w);
+	else
+		glUniform4f(location, x, y, z, w);
+}
+
+void FFGLShader::SetUniform1fv(GLint location, GLsizei count, const GLfloat *values)
+{
+	if (!IsUniformChanged(location, values, count*sizeof(GLfloat)))
+		return;
+
+	if (GLEE_ARB_separate_shader_objects)
+		glProgramUniform1fv(m_glProgram, location, count, values);
+	else
+		glUniform1fv(location, count, values);
+}
+
+void FFGLShader::SetUniform3fv(GLint location, GLsizei count, const GLfloat *values)
+{
+	if (!IsUniformChanged(location, values, count*3*sizeof(GLfloat)))
+		return;
+
+	if (GLEE_ARB_separate_shader_objects)
+		glProgramUniform3fv(m_glProgram, location, count, values);
+	else
+		glUniform3fv(location, count, values);
+}
+
+void FFGLShader::SetUniform4fv(GLint location, GLsizei count, const GLfloat *values)
+{
+	if (!IsUniformChanged(location, values, count*4*sizeof(GLfloat)))
+		return;
+
+	if (GLEE_ARB_separate_shader_objects)
+		glProgramUniform4fv(m_glProgram, location, count, values);
+	else
+		glUniform4fv(location, count, values);
+}
+
+void FFGLShader::GetUniformCounts(unsigned int &uploaded, unsigned int &skipped)
+{
+	uploaded = m_uploaded;
+	skipped = m_skipped;
+}
+
+void FFGLShader::SetProgramCache(FFGLProgramCache *cache)
+{
+	m_programCache = cache;
+}
+
+int FFGLShader::IsFromCache()
+{
+	return m_cached;
+}
+
+int FFGLShader::SaveToCache()
+{
+	if (m_programCache==NULL || !m_programCache->IsEnabled() || m_cached || !IsReady())
+		return 0;
+
+	m_cached = m_programCache->Save(m_cacheKey, m_glProgram, m_uniforms);
+
+	return m_cached;
+}
+
+GLuint64 FFGLShader::HashSource(const char *vtxProgram, const char *fragProgram)
+{
+	const char *strings[] = { fragProgram };
+
+	return HashSource(vtxProgram, 1, strings, NULL);
+}
+
+//64 bit FNV-1a of both sources including their terminators.
+//the parts of the fragment program hash the same as one string
+GLuint64 FFGLShader::HashSource(const char *vtxProgram, int fragCount, const char **fragStrings, const GLint *fragLengths)
+{
+	GLuint64 hash = 14695981039346656037ULL;
+	const char *text = vtxProgram ? vtxProgram : "";
+
+	do
+	{
+		hash ^= (unsigned char)*text;
+		hash *= 1099511628211ULL;
+	} while (*text++);
+
+	for (int i = 0; i < fragCount; i++)
+	{
+		if (fragStrings[i]==NULL)
+			continue;
+
+		size_t length = (fragLengths!=NULL && fragLengths[i] >= 0) ? (size_t)fragLengths[i] : strlen(fragStrings[i]);
+		for (size_t j = 0; j < length; j++)
+		{
+			hash ^= (unsigned char)fragStrings[i][j];
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	//terminator
+	hash *= 1099511628211ULL;
+
+	return hash;
+}
+
+GLuint64 FFGLShader::GetSourceKey()
+{
+	return m_sourceKey;
+}
+
+//the size of the program binary is the best estimate available
+//of what the driver holds for it
+GLint FFGLShader::GetProgramSize()
+{
+	GLint size = 0;
+
+	if (m_glProgram!=0 && GLEE_ARB_get_program_binary)
+		glGetProgramiv(m_glProgram, GL_PROGRAM_BINARY_LENGTH, &size);
+
+	if (size <= 0)
+		size = 256*1024;
+
+	return size;
+}
+
+GLuint FFGLShader::CreateVertexShader(const char *vtxProgram)
+{
+	GLuint glShader;
+	GLint compileSuccess = 0;
+
+	if (vtxProgram==NULL || vtxProgram[0]==0)
+		return 0;
+
+	glShader = glCreateShader(GL_VERTEX_SHADER_ARB);
+	if (glShader==0)
+		return 0;
+
+	glShaderSource(glShader, 1, &vtxProgram, NULL);
+	glCompileShader(glShader);
+
+	glGetShaderiv(glShader, GL_COMPILE_STATUS, &compileSuccess);
+	if (compileSuccess!=GL_TRUE)
+	{
+		CheckCompileStatus(glShader, "Vertex");
+		glDeleteShader(glShader);
+		return 0;
+	}
+
+	return glShader;
+}
+
+//only takes effect the next time the gl resources are created
+void FFGLShader::SetVertexShader(GLuint glShader)
+{
+	m_glSharedVertexShader = glShader;
+}
+
+void FFGLShader::BindAttribLocation(GLuint index, const char *name)
+{
+	for (size_t i = 0; i < m_attribLocations.size(); i++)
+	{
+		if (m_attribLocations[i].second==name)
+		{
+			m_attribLocations[i].first = index;
+			return;
+		}
+	}
+
+	m_attribLocations.push_back(std::make_pair(index, std::string(name)));
 }
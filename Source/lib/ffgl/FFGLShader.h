@@ -2,7 +2,27 @@
 #define FFGLShader_H
 
 #include <FFGL.h>
+#include <FFGLProgramCache.h>
 #include <string>
+#include <vector>
+
+//a uniform the linked program uses
+struct FFGLActiveUniform
+{
+	std::string name; //without "[0]" for an array
+	GLint location;
+	GLint size;       //number of array elements
+	GLenum type;
+};
+
+//last value uploaded to a uniform
+#define FFGLSHADER_MAX_SHADOW 64 //bytes
+struct FFGLUniformShadow
+{
+	GLint location;
+	GLsizei size;
+	unsigned char data[FFGLSHADER_MAX_SHADOW];
+};
 
 class FFGLShader
 {
@@ -15,17 +35,80 @@ public:
 	int Compile(const char *vtxProgram, const char *fragProgram);	
 	int Compile(const std::string& vtxProgram, const std::string& fragProgram);
 
+	// Compile without waiting for the driver. Call BeginCompile, poll
+	// IsCompileComplete once per frame and then EndCompile for the link status.
+	int BeginCompile(const char *vtxProgram, const char *fragProgram);
+	// The fragment program in several parts as for glShaderSource. A length
+	// less than zero means the string is null terminated.
+	int BeginCompile(const char *vtxProgram, int fragCount, const char **fragStrings, const GLint *fragLengths);
+	int IsCompileComplete();
+	int EndCompile();
+
+	// Linked programs are loaded from and saved to the cache if one is set.
+	// SaveToCache stores the uniform locations found so far with the binary.
+	void SetProgramCache(FFGLProgramCache *cache);
+	int IsFromCache();
+	int SaveToCache();
+
+	// Hash identifying the source of a program
+	static GLuint64 HashSource(const char *vtxProgram, const char *fragProgram);
+	static GLuint64 HashSource(const char *vtxProgram, int fragCount, const char **fragStrings, const GLint *fragLengths);
+	GLuint64 GetSourceKey();
+
+	// Estimate of the driver memory used by the program
+	GLint GetProgramSize();
+
+	// A vertex shader compiled once by CreateVertexShader can be attached to
+	// many programs instead of each compiling its own. It is not deleted by
+	// FreeGLResources, so the caller deletes it once no program uses it.
+	static GLuint CreateVertexShader(const char *vtxProgram);
+	void SetVertexShader(GLuint glShader);
+
+	// Generic attribute locations applied before each link, for a vertex
+	// shader that reads its inputs from attributes instead of gl_Vertex.
+	void BindAttribLocation(GLuint index, const char *name);
+
 	GLuint FindUniform(const char *name);
+	int GetActiveUniforms(std::vector<FFGLActiveUniform> &uniforms);
+	int BindUniformBlock(const char *name, GLuint binding);
+
+	// Uniform uploads that are skipped if the program already has the value.
+	// With ARB_separate_shader_objects the program does not have to be bound,
+	// otherwise call BindShader first.
+	void SetUniform1i(GLint location, GLint value);
+	void SetUniform1f(GLint location, GLfloat x);
+	void SetUniform2f(GLint location, GLfloat x, GLfloat y);
+	void SetUniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z);
+	void SetUniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+	void SetUniform1fv(GLint location, GLsizei count, const GLfloat *values);
+	void SetUniform3fv(GLint location, GLsizei count, const GLfloat *values);
+	void SetUniform4fv(GLint location, GLsizei count, const GLfloat *values);
+	void GetUniformCounts(unsigned int &uploaded, unsigned int &skipped);
 	int BindShader();
 	int UnbindShader();
+	GLuint GetProgram() { return m_glProgram; }
 	void FreeGLResources();
 
 private:
 	GLenum m_glProgram;
 	GLenum m_glVertexShader;
 	GLenum m_glFragmentShader;
+	GLenum m_glSharedVertexShader;
 	GLuint m_linkStatus;
+	int m_compilePending;
+	FFGLProgramCache *m_programCache;
+	GLuint64 m_cacheKey;
+	GLuint64 m_sourceKey;
+	int m_cached;
+	std::vector<FFGLCachedUniform> m_uniforms;
+	std::vector<FFGLUniformShadow> m_shadow;
+	std::vector<std::pair<GLuint, std::string> > m_attribLocations;
+	unsigned int m_uploaded;
+	unsigned int m_skipped;
 	void CreateGLResources();
+	int IsUniformChanged(GLint location, const void *data, GLsizei size);
+	void AttachShader(GLenum glShader);
+	static int CheckCompileStatus(GLenum glShader, const char *type);
 };
 
 #endif
@@ -0,0 +1,134 @@
+#include "FFGLStateCache.h"
+
+//value of a binding that has to be set before it is known
+#define FFGLSTATECACHE_UNKNOWN 0xFFFFFFFF
+
+FFGLStateCache::FFGLStateCache() :
+	m_extensions(NULL),
+	m_hostFbo(0)
+{
+	Invalidate();
+}
+
+FFGLStateCache::~FFGLStateCache()
+{
+}
+
+void FFGLStateCache::Initialize(FFGLExtensions *extensions)
+{
+	m_extensions = extensions;
+	Invalidate();
+}
+
+//the state the host hands over at the start of ProcessOpenGL
+void FFGLStateCache::Reset(GLuint hostFbo)
+{
+	m_hostFbo       = hostFbo;
+	m_activeTexture = GL_TEXTURE0;
+	m_fbo           = hostFbo;
+	m_program       = 0;
+	m_vertexArray   = 0;
+	m_texture2D     = 0;
+
+	for (int i = 0; i < FFGLSTATECACHE_TEXTURE_UNITS; i++)
+		m_textures[i] = 0;
+}
+
+//back to the state from Reset, unit 0 is left active
+void FFGLStateCache::Restore()
+{
+	for (int i = FFGLSTATECACHE_TEXTURE_UNITS-1; i >= 0; i--)
+		BindTexture(GL_TEXTURE0 + i, 0);
+
+	ActiveTexture(GL_TEXTURE0);
+	EnableTexture2D(false);
+	UseProgram(0);
+	BindVertexArray(0);
+	BindFramebuffer(m_hostFbo);
+}
+
+//forget everything so the next call of each kind reaches GL
+void FFGLStateCache::Invalidate()
+{
+	m_activeTexture = FFGLSTATECACHE_UNKNOWN;
+	m_fbo           = FFGLSTATECACHE_UNKNOWN;
+	m_program       = FFGLSTATECACHE_UNKNOWN;
+	m_vertexArray   = FFGLSTATECACHE_UNKNOWN;
+	m_texture2D     = -1;
+
+	for (int i = 0; i < FFGLSTATECACHE_TEXTURE_UNITS; i++)
+		m_textures[i] = FFGLSTATECACHE_UNKNOWN;
+}
+
+void FFGLStateCache::ActiveTexture(GLenum unit)
+{
+	if (unit==m_activeTexture)
+		return;
+
+	m_extensions->glActiveTexture(unit);
+	m_activeTexture = unit;
+}
+
+void FFGLStateCache::BindTexture(GLenum unit, GLuint texture)
+{
+	GLuint index = unit - GL_TEXTURE0;
+
+	//units past the tracked ones are always bound
+	if (index >= FFGLSTATECACHE_TEXTURE_UNITS)
+	{
+		ActiveTexture(unit);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		return;
+	}
+
+	if (texture==m_textures[index])
+		return;
+
+	ActiveTexture(unit);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	m_textures[index] = texture;
+}
+
+void FFGLStateCache::BindFramebuffer(GLuint fbo)
+{
+	if (fbo==m_fbo)
+		return;
+
+	m_extensions->glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+	m_fbo = fbo;
+}
+
+void FFGLStateCache::UseProgram(GLuint program)
+{
+	if (program==m_program)
+		return;
+
+	glUseProgram(program);
+	m_program = program;
+}
+
+void FFGLStateCache::BindVertexArray(GLuint vao)
+{
+	if (vao==m_vertexArray)
+		return;
+
+	//without vertex array objects there is only ever the default one
+	if (GLEE_ARB_vertex_array_object || m_extensions->CoreProfile)
+		glBindVertexArray(vao);
+	m_vertexArray = vao;
+}
+
+//only tracked for unit 0, which is made active
+void FFGLStateCache::EnableTexture2D(bool enable)
+{
+	ActiveTexture(GL_TEXTURE0);
+
+	if ((int)enable==m_texture2D)
+		return;
+
+	if (enable)
+		glEnable(GL_TEXTURE_2D);
+	else
+		glDisable(GL_TEXTURE_2D);
+	m_texture2D = (int)enable;
+}
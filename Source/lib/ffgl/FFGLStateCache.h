@@ -0,0 +1,50 @@
+#ifndef FFGLStateCache_H
+#define FFGLStateCache_H
+
+#include <FFGL.h>
+#include <FFGLExtensions.h>
+
+#define FFGLSTATECACHE_TEXTURE_UNITS 8 //units with tracked GL_TEXTURE_2D bindings
+
+//Tracks the GL state a plugin changes during ProcessOpenGL and drops calls
+//that would not change it.
+//
+//The FFGL spec has the host hand over the context in its default state:
+//texture unit 0 active, no textures bound, no program, GL_TEXTURE_2D disabled
+//and the host fbo bound. No vertex array object is bound either. Reset records that state without querying GL, and
+//Restore puts back only what was changed since, as the plugin has to before
+//returning. Anything bound outside the cache between Reset and Restore
+//must be followed by Invalidate.
+class FFGLStateCache
+{
+public:
+	FFGLStateCache();
+	virtual ~FFGLStateCache();
+
+	void Initialize(FFGLExtensions *extensions);
+
+	void Reset(GLuint hostFbo);
+	void Restore();
+	void Invalidate();
+
+	void ActiveTexture(GLenum unit);
+	void BindTexture(GLenum unit, GLuint texture);
+	void BindFramebuffer(GLuint fbo);
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vao);
+	void EnableTexture2D(bool enable);
+
+	GLuint GetHostFbo() { return m_hostFbo; }
+
+private:
+	FFGLExtensions *m_extensions;
+	GLuint m_hostFbo;
+	GLenum m_activeTexture;
+	GLuint m_textures[FFGLSTATECACHE_TEXTURE_UNITS];
+	GLuint m_fbo;
+	GLuint m_program;
+	GLuint m_vertexArray;
+	int m_texture2D; //-1 when not known
+};
+
+#endif
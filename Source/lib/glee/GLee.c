@@ -20268,6 +20268,30 @@ int __GLeeGetVersionNumber(char *versionStr)
 	return major<<8 | minor;
 }
 
+typedef const GLubyte * (APIENTRYP __GLeePFNGETSTRINGIPROC) (GLenum  name, GLuint  index);
+
+GLboolean __GLeeGetExtensionsIndexed(ExtensionList* extList)
+{
+	__GLeePFNGETSTRINGIPROC getStringi;
+	GLint numExtensions=0;
+	GLint a;
+	const char * name;
+
+	glGetError(); /* clear the GL_INVALID_ENUM from glGetString(GL_EXTENSIONS) */
+	getStringi=(__GLeePFNGETSTRINGIPROC)__GLeeGetProcAddress("glGetStringi");
+	if (getStringi==0) return GL_FALSE;
+
+	glGetIntegerv(GL_NUM_EXTENSIONS,&numExtensions);
+	if (glGetError()!=GL_NO_ERROR) return GL_FALSE;
+
+	for (a=0;a<numExtensions;a++)
+	{
+		name=(const char *)getStringi(GL_EXTENSIONS,(GLuint)a);
+		if (name) __GLeeExtList_add(extList,name);
+	}
+	return GL_TRUE;
+}
+
 GLboolean __GLeeGetExtensions(ExtensionList* extList)
 {
        const char * platExtStr;
@@ -20285,8 +20309,13 @@ GLboolean __GLeeGetExtensions(ExtensionList* extList)
        glExtStr=(const char *)glGetString(GL_EXTENSIONS);
        if (glExtStr==0)
 	{
-		__GLeeWriteError("glGetString(GL_EXTENSIONS) failed.");
-		return GL_FALSE;
+		/* a core profile context has no extension string, so list them one at a time */
+		if (!__GLeeGetExtensionsIndexed(extList))
+		{
+			__GLeeWriteError("glGetString(GL_EXTENSIONS) failed.");
+			return GL_FALSE;
+		}
+		glExtStr="";
 	}
 
        /* If the last character of platExtStr is not a space, we need to add one when we concatenate the extension strings*/
@@ -0,0 +1,141 @@
+//
+//		GPUTimer.cpp
+//
+//		GPU time of a frame from timer queries.
+//
+//		The time is the difference of two GL_TIMESTAMP queries. A
+//		GL_TIME_ELAPSED query would fail while a host has one of its own
+//		running, and its end would end the host's query instead.
+//
+//		The pairs of queries are used in turn. A result is read only once it is
+//		available, and if all of them are still waiting the oldest one
+//		is dropped and used again.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#include "GPUTimer.h"
+
+
+GPUTimer::GPUTimer()
+{
+	for(int i = 0; i < GPUTIMER_QUERIES; i++) {
+		m_queries[i][0] = 0;
+		m_queries[i][1] = 0;
+		m_tags[i]       = 0;
+	}
+	m_first    = 0;
+	m_count    = 0;
+	m_bRunning = false;
+}
+
+GPUTimer::~GPUTimer()
+{
+	// The context has gone by now, so the driver releases the queries
+}
+
+bool GPUTimer::Create()
+{
+	if(m_queries[0][0])
+		return true;
+
+	glGenQueries(GPUTIMER_QUERIES*2, &m_queries[0][0]);
+	m_first    = 0;
+	m_count    = 0;
+	m_bRunning = false;
+
+	return (m_queries[0][0] != 0);
+}
+
+void GPUTimer::Release()
+{
+	if(m_queries[0][0])
+		glDeleteQueries(GPUTIMER_QUERIES*2, &m_queries[0][0]);
+	for(int i = 0; i < GPUTIMER_QUERIES; i++) {
+		m_queries[i][0] = 0;
+		m_queries[i][1] = 0;
+	}
+	m_count    = 0;
+	m_bRunning = false;
+}
+
+bool GPUTimer::IsReady()
+{
+	return (m_queries[0][0] != 0);
+}
+
+void GPUTimer::Begin()
+{
+	if(!m_queries[0][0] || m_bRunning)
+		return;
+
+	// Using a pair again discards the result it is waiting for
+	if(m_count == GPUTIMER_QUERIES) {
+		m_first = (m_first + 1) % GPUTIMER_QUERIES;
+		m_count--;
+	}
+
+	glQueryCounter(m_queries[(m_first + m_count) % GPUTIMER_QUERIES][0], GL_TIMESTAMP);
+	m_bRunning = true;
+}
+
+void GPUTimer::End(int tag)
+{
+	if(!m_bRunning)
+		return;
+
+	glQueryCounter(m_queries[(m_first + m_count) % GPUTIMER_QUERIES][1], GL_TIMESTAMP);
+	m_tags[(m_first + m_count) % GPUTIMER_QUERIES] = tag;
+	m_count++;
+	m_bRunning = false;
+}
+
+bool GPUTimer::GetResult(double &ms, int *tag)
+{
+	bool bResult = false;
+
+	// Results are available in the order the queries ended
+	while(m_count > 0) {
+		GLuint available = 0;
+		GLuint64 start = 0;
+		GLuint64 end = 0;
+
+		// The end is later in the command stream, so the start is available with it
+		glGetQueryObjectuiv(m_queries[m_first][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if(!available)
+			break;
+
+		glGetQueryObjectui64v(m_queries[m_first][0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(m_queries[m_first][1], GL_QUERY_RESULT, &end);
+		ms = (end > start) ? (double)(end - start)/1000000.0 : 0.0;
+		if(tag)
+			*tag = m_tags[m_first];
+		bResult = true;
+
+		m_first = (m_first + 1) % GPUTIMER_QUERIES;
+		m_count--;
+	}
+
+	return bResult;
+}
@@ -0,0 +1,72 @@
+//
+//		GPUTimer.h
+//
+//		GPU time of a frame from timestamp queries, read a few frames later
+//		so that the CPU never waits for the GPU.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#pragma once
+#ifndef GPUTimer_H
+#define GPUTimer_H
+
+#include <FFGL.h>
+
+#define GPUTIMER_QUERIES 4 // frames that can be waiting for a result
+
+class GPUTimer
+{
+
+public:
+
+	GPUTimer();
+	~GPUTimer();
+
+	// Needs ARB_timer_query, which the caller checks
+	bool Create();
+	void Release();
+	bool IsReady();
+
+	// Timestamps do not nest like GL_TIME_ELAPSED queries, so a host can
+	// time the frame with its own query around these. The tag is returned
+	// with the result, for the work that was done in the frame.
+	void Begin();
+	void End(int tag = 0);
+
+	// The time in milliseconds of the latest frame with a result. False if
+	// no frame has finished since the last call.
+	bool GetResult(double &ms, int *tag = NULL);
+
+protected:
+
+	GLuint m_queries[GPUTIMER_QUERIES][2]; // the timestamps at Begin and End
+	int m_tags[GPUTIMER_QUERIES];
+	int m_first;   // the oldest query waiting for a result
+	int m_count;   // queries waiting for a result
+	bool m_bRunning;
+
+};
+
+#endif
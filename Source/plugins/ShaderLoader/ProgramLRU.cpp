@@ -0,0 +1,115 @@
+//
+//		ProgramLRU.cpp
+//
+//		Linked shader programs that are no longer shown by any plugin instance.
+//
+//		When an instance replaces its shader the old program is added here instead
+//		of being deleted. Loading the same source again takes it back out, so the
+//		switch is a swap of program objects. The cache is bounded by the number of
+//		programs and by an estimate of driver memory from the program binary size,
+//		and the least recently used programs are deleted first.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#include <FFGL.h>
+#include <algorithm> // for std::swap
+
+#include "ProgramLRU.h"
+
+
+ProgramLRU::ProgramLRU(unsigned int maxPrograms, unsigned int maxMemoryMB)
+{
+	m_maxPrograms = maxPrograms;
+	m_maxMemory   = (GLint64)maxMemoryMB*1024*1024;
+	m_memory      = 0;
+}
+
+ProgramLRU::~ProgramLRU()
+{
+	// The context has gone by now, so the driver releases the programs
+	m_programs.clear();
+}
+
+void ProgramLRU::Add(FFGLShader &shader)
+{
+	if(!shader.IsReady()) {
+		shader.FreeGLResources();
+		return;
+	}
+
+	// Replace an older copy of the same source
+	GLuint64 key = shader.GetSourceKey();
+	for(std::list<ProgramEntry>::iterator it = m_programs.begin(); it != m_programs.end(); it++) {
+		if(it->key == key) {
+			m_memory -= it->size;
+			it->shader.FreeGLResources();
+			m_programs.erase(it);
+			break;
+		}
+	}
+
+	m_programs.push_front(ProgramEntry());
+	ProgramEntry &entry = m_programs.front();
+	entry.key  = key;
+	entry.size = shader.GetProgramSize();
+	std::swap(entry.shader, shader);
+	m_memory += entry.size;
+
+	Trim();
+}
+
+bool ProgramLRU::Take(GLuint64 key, FFGLShader &shader)
+{
+	for(std::list<ProgramEntry>::iterator it = m_programs.begin(); it != m_programs.end(); it++) {
+		if(it->key == key) {
+			shader.FreeGLResources();
+			std::swap(it->shader, shader);
+			m_memory -= it->size;
+			m_programs.erase(it);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ProgramLRU::Clear()
+{
+	for(std::list<ProgramEntry>::iterator it = m_programs.begin(); it != m_programs.end(); it++)
+		it->shader.FreeGLResources();
+	m_programs.clear();
+	m_memory = 0;
+}
+
+// Delete the least recently used programs until within both limits
+void ProgramLRU::Trim()
+{
+	while(!m_programs.empty() && (m_programs.size() > m_maxPrograms || m_memory > m_maxMemory)) {
+		ProgramEntry &entry = m_programs.back();
+		m_memory -= entry.size;
+		entry.shader.FreeGLResources();
+		m_programs.pop_back();
+	}
+}
@@ -0,0 +1,73 @@
+//
+//		ProgramLRU.h
+//
+//		Linked shader programs that are no longer shown by any plugin instance,
+//		kept with their uniform locations so that switching back to a recent
+//		shader needs no compile.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#pragma once
+#ifndef ProgramLRU_H
+#define ProgramLRU_H
+
+#include <FFGLShader.h>
+#include <list>
+
+class ProgramLRU
+{
+
+public:
+
+	ProgramLRU(unsigned int maxPrograms, unsigned int maxMemoryMB);
+	~ProgramLRU();
+
+	// Keep a linked shader. The program moves into the cache and shader is left empty.
+	void Add(FFGLShader &shader);
+
+	// Move the shader with this source key out of the cache into shader
+	bool Take(GLuint64 key, FFGLShader &shader);
+
+	// Release every program. Needs the OpenGL context.
+	void Clear();
+
+protected:
+
+	struct ProgramEntry {
+		GLuint64 key;
+		GLint size;
+		FFGLShader shader;
+	};
+
+	std::list<ProgramEntry> m_programs; // most recently used first
+	unsigned int m_maxPrograms;
+	GLint64 m_maxMemory;
+	GLint64 m_memory;
+
+	void Trim();
+
+};
+
+#endif
@@ -0,0 +1,106 @@
+//
+//		ProgramRegistry.cpp
+//
+//		Linked shader programs shared by all plugin instances in the process.
+//
+//		Instances that load the same final shader source use the same program
+//		object, so several clips with the same shader compile it once and the
+//		driver holds one copy. Each program is reference counted and when the
+//		last instance releases it, it moves to the recently used list so that
+//		loading it again needs no compile.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#include <FFGL.h>
+
+#include "ProgramRegistry.h"
+
+
+ProgramRegistry::ProgramRegistry(unsigned int maxUnused, unsigned int maxUnusedMB) : m_unused(maxUnused, maxUnusedMB)
+{
+}
+
+ProgramRegistry::~ProgramRegistry()
+{
+	// The context has gone by now, so the driver releases the programs
+	for(size_t i = 0; i < m_shared.size(); i++)
+		delete m_shared[i].shader;
+	m_shared.clear();
+}
+
+FFGLShader *ProgramRegistry::Acquire(GLuint64 key)
+{
+	for(size_t i = 0; i < m_shared.size(); i++) {
+		if(m_shared[i].key == key) {
+			m_shared[i].refs++;
+			return m_shared[i].shader;
+		}
+	}
+
+	FFGLShader *shader = new FFGLShader;
+	if(!m_unused.Take(key, *shader)) {
+		delete shader;
+		return NULL;
+	}
+
+	return Add(shader);
+}
+
+FFGLShader *ProgramRegistry::Add(FFGLShader *shader)
+{
+	SharedProgram program;
+
+	program.key    = shader->GetSourceKey();
+	program.refs   = 1;
+	program.shader = shader;
+	m_shared.push_back(program);
+
+	return shader;
+}
+
+void ProgramRegistry::Release(FFGLShader *shader)
+{
+	for(size_t i = 0; i < m_shared.size(); i++) {
+		if(m_shared[i].shader == shader) {
+			if(--m_shared[i].refs > 0)
+				return;
+			// ProgramLRU frees a program that did not link
+			m_unused.Add(*shader);
+			delete shader;
+			m_shared.erase(m_shared.begin() + i);
+			return;
+		}
+	}
+}
+
+void ProgramRegistry::Clear()
+{
+	for(size_t i = 0; i < m_shared.size(); i++) {
+		m_shared[i].shader->FreeGLResources();
+		delete m_shared[i].shader;
+	}
+	m_shared.clear();
+	m_unused.Clear();
+}
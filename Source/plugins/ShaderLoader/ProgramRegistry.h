@@ -0,0 +1,74 @@
+//
+//		ProgramRegistry.h
+//
+//		Linked shader programs shared by all plugin instances in the process.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#pragma once
+#ifndef ProgramRegistry_H
+#define ProgramRegistry_H
+
+#include <FFGLShader.h>
+#include "ProgramLRU.h"
+#include <vector>
+
+class ProgramRegistry
+{
+
+public:
+
+	ProgramRegistry(unsigned int maxUnused, unsigned int maxUnusedMB);
+	~ProgramRegistry();
+
+	// The shader for this source key if another instance is using it or it
+	// was used recently, with a reference added. NULL if it has to be compiled.
+	FFGLShader *Acquire(GLuint64 key);
+
+	// Share a shader that has started compiling. The registry owns it from
+	// now on and the caller holds one reference.
+	FFGLShader *Add(FFGLShader *shader);
+
+	// Release a reference. Programs no longer used by any instance are kept
+	// in the recently used list until it is full.
+	void Release(FFGLShader *shader);
+
+	// Release every program. Needs the OpenGL context.
+	void Clear();
+
+protected:
+
+	struct SharedProgram {
+		GLuint64 key;
+		int refs;
+		FFGLShader *shader;
+	};
+
+	std::vector<SharedProgram> m_shared;
+	ProgramLRU m_unused;
+
+};
+
+#endif
@@ -0,0 +1,128 @@
+//
+//		ResolutionScaler.cpp
+//
+//		Chooses the scale of the viewport a shader renders at from the GPU time
+//		of earlier frames.
+//
+//		The fragment cost is taken to be in proportion to the number of pixels,
+//		so the time at another scale is the average time multiplied by the
+//		square of the change. The new scale is rounded down to a step so that
+//		render targets of only a few sizes are made.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#include <math.h>
+
+#include "ResolutionScaler.h"
+
+#define RESOLUTIONSCALER_SMOOTHING (0.25) // of each new sample in the average
+
+
+ResolutionScaler::ResolutionScaler()
+{
+	m_budget     = 16.0;
+	m_minScale   = 0.25f;
+	m_maxScale   = 1.0f;
+	m_hysteresis = 0.1f;
+	Reset();
+}
+
+ResolutionScaler::~ResolutionScaler()
+{
+}
+
+void ResolutionScaler::SetBudget(double budget)
+{
+	m_budget = budget;
+}
+
+void ResolutionScaler::SetBounds(float minScale, float maxScale)
+{
+	if(minScale < RESOLUTIONSCALER_STEP) minScale = RESOLUTIONSCALER_STEP;
+	if(maxScale > 1.0f) maxScale = 1.0f;
+	if(maxScale < minScale) maxScale = minScale;
+
+	m_minScale = minScale;
+	m_maxScale = maxScale;
+	Clamp();
+}
+
+void ResolutionScaler::SetHysteresis(float hysteresis)
+{
+	if(hysteresis < 0.0f) hysteresis = 0.0f;
+	if(hysteresis > 0.5f) hysteresis = 0.5f;
+
+	m_hysteresis = hysteresis;
+}
+
+void ResolutionScaler::Reset()
+{
+	m_scale   = m_maxScale;
+	m_average = -1.0;
+	m_settle  = 0;
+}
+
+void ResolutionScaler::AddSample(double ms)
+{
+	// Frames rendered before the last change are still coming in
+	if(m_settle > 0) {
+		m_settle--;
+		return;
+	}
+
+	if(m_average < 0.0)
+		m_average = ms;
+	else
+		m_average += (ms - m_average)*RESOLUTIONSCALER_SMOOTHING;
+
+	if(m_average <= 0.0)
+		return;
+
+	// The largest scale expected to be the target time or less
+	double target = m_budget*(1.0 - m_hysteresis);
+	float scale = (float)(m_scale*sqrt(target/m_average));
+	scale = floorf(scale/RESOLUTIONSCALER_STEP)*RESOLUTIONSCALER_STEP;
+	if(scale < m_minScale) scale = m_minScale;
+	if(scale > m_maxScale) scale = m_maxScale;
+
+	// Lowered only when over the budget, but raised whenever a step fits under the target
+	if(scale == m_scale || (scale < m_scale && m_average <= m_budget))
+		return;
+
+	m_scale   = scale;
+	m_average = -1.0;
+	m_settle  = RESOLUTIONSCALER_SETTLE;
+}
+
+float ResolutionScaler::GetScale()
+{
+	return m_scale;
+}
+
+void ResolutionScaler::Clamp()
+{
+	if(m_scale < m_minScale) m_scale = m_minScale;
+	if(m_scale > m_maxScale) m_scale = m_maxScale;
+}
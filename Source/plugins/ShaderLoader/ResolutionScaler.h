@@ -0,0 +1,79 @@
+//
+//		ResolutionScaler.h
+//
+//		Chooses the scale of the viewport a shader renders at from the GPU time
+//		of earlier frames, so that the frame time stays within a budget.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#pragma once
+#ifndef ResolutionScaler_H
+#define ResolutionScaler_H
+
+#define RESOLUTIONSCALER_STEP   (0.0625f) // scales are a multiple of this
+#define RESOLUTIONSCALER_SETTLE (4)       // frames ignored after a change
+
+class ResolutionScaler
+{
+
+public:
+
+	ResolutionScaler();
+	~ResolutionScaler();
+
+	// The frame time to keep within, in milliseconds
+	void SetBudget(double budget);
+
+	// The range of the scale of each side of the viewport
+	void SetBounds(float minScale, float maxScale);
+
+	// The scale is lowered when the frame time is over the budget and then aims
+	// for this fraction of the budget below it, which it is only raised for.
+	void SetHysteresis(float hysteresis);
+
+	// Back to the largest scale
+	void Reset();
+
+	// The GPU time of a frame, which was rendered at the current scale
+	// unless the scale has changed in the last few frames
+	void AddSample(double ms);
+
+	float GetScale();
+
+protected:
+
+	double m_budget;
+	float m_minScale;
+	float m_maxScale;
+	float m_hysteresis;
+	float m_scale;
+	double m_average; // frame time at the current scale, less than zero with no samples
+	int m_settle;     // samples still to be ignored
+
+	void Clamp();
+
+};
+
+#endif
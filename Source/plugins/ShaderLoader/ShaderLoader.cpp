@@ -28,6 +28,35 @@
 //					Version 1.004
 //		26.03.15	Changed from LGPL to Simplified BSD licence
 //		11-17-17	version 2.0 updating for 64 bit resolume 6
+//		17-10-26	SetTime supported so that a host can drive the shader time
+//					Shaders compile in the background and replace the current shader
+//					once linked. Removed duplicate compile.
+//					Linked program binaries cached on disk
+//					Recently used programs kept in memory for instant switching
+//					Programs and the vertex shader shared by all instances
+//					The shader file is watched and reloaded when saved with a change.
+//					Removed the Reload parameter.
+//					Shader files are read by a tokenizer instead of string searches
+//					Only the ShaderToy uniforms that a shader uses are added and looked up
+//					Uniforms bound from a table of semantics. Added iTime, iTimeDelta and iFrame.
+//					ShaderToy globals in a uniform block written to a ring buffer
+//					Unchanged uniform values are not uploaded again
+//					Texture, fbo and program bindings tracked so that unchanged state is not set again.
+//					Viewport taken from InitGL and Resize instead of read every frame.
+//					Input textures sampled without a copy if the shader only uses texture calls,
+//					otherwise copied with glCopyImageSubData or glBlitFramebuffer
+//					Four input channels. Local input textures reused from a pool.
+//					Pool of render targets for intermediate passes, under a memory budget
+//					Drawn as one triangle from a vertex array object, immediate mode only as a fallback
+//					Shaders translated to GLSL 3.30 core on a core profile context
+//					ShaderToy Buffer A to D passes from files next to the shader,
+//					rendered to ping-pong render targets from the pool
+//					GLSL Sandbox backbuffer is the previous frame instead of input 0
+//					Dynamic resolution within a GPU frame time budget
+//					Checkerboard rendering of a half or a quarter of the pixels each frame
+//					Render rate divider that draws the last output again between rendered frames
+//					Shaders that do not read the time are rendered again only when something changes
+//					Progressive rendering in tiles spread over frames within a GPU time budget
 //
 //		------------------------------------------------------------
 //
@@ -62,6 +91,7 @@
 #include <string>
 #include <fstream>
 #include <limits>
+#include <algorithm>
 #include <time.h> // for date
 #include <Shlobj.h> // to get the program folder path
 #include <Shlwapi.h> // for PathStripPath
@@ -80,6 +110,11 @@ extern "C" IMAGE_DOS_HEADER __ImageBase;
 #define GL_TEXTURE_WRAP_R			0x8072
 #define GL_MIRRORED_REPEAT			0x8370
 
+// ARB_copy_image is not in GLee
+typedef void (APIENTRY *PFNGLCOPYIMAGESUBDATAPROC)(GLuint srcName, GLenum srcTarget, GLint srcLevel, GLint srcX, GLint srcY, GLint srcZ,
+												   GLuint dstName, GLenum dstTarget, GLint dstLevel, GLint dstX, GLint dstY, GLint dstZ,
+												   GLsizei srcWidth, GLsizei srcHeight, GLsizei srcDepth);
+
 
 #define M_PI 3.1415926535897932384626433832795
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
@@ -89,7 +124,7 @@ extern "C" IMAGE_DOS_HEADER __ImageBase;
 #define FFPARAM_UPDATE      (1)
 #define FFPARAM_SELECT      (2)
 #define FFPARAM_EDIT        (3)
-#define FFPARAM_RELOAD      (4)
+#define FFPARAM_RELOAD      (4) // kept so that hosts find the other parameters at the same index
 #define FFPARAM_SPEED       (5)
 #define FFPARAM_MOUSEX      (6)
 #define FFPARAM_MOUSEY      (7)
@@ -99,9 +134,46 @@ extern "C" IMAGE_DOS_HEADER __ImageBase;
 #define FFPARAM_GREEN       (11)
 #define FFPARAM_BLUE        (12)
 #define FFPARAM_ALPHA       (13)
+#define FFPARAM_BUDGET      (14)
+#define FFPARAM_CHECKERBOARD (15)
+#define FFPARAM_RENDERRATE  (16)
+#define FFPARAM_TILEBUDGET  (17)
 
 #define STRINGIFY(A) #A
 
+// Program binary cache in the user's local application data folder
+#define PROGRAM_CACHE_FOLDER "Leading Edge\\ShaderLoader\\ProgramCache"
+#define PROGRAM_CACHE_SIZE   (64) // MB
+#define PLUGIN_VERSION       "2.000"
+
+// ShaderToy globals uniform block
+#define GLOBALS_BINDING      (0)
+#define GLOBALS_RING_SLOTS   (192) // blocks written before the ring wraps
+
+// Programs not used by any instance kept in memory
+#define PROGRAM_LRU_COUNT    (16)
+#define PROGRAM_LRU_MEMORY   (64) // MB
+
+// Local copies of input textures released by instances
+#define TEXTURE_POOL_FREE    (8)    // free textures kept at most
+#define TEXTURE_POOL_KEEP    (3000) // milliseconds a free texture is kept for
+
+// Render targets for passes before the output
+#define RENDER_TARGET_BUDGET (256) // MB
+
+// Dynamic resolution, with defaults for the pragmas that set it for a shader
+#define MAX_FRAME_BUDGET     (33.3f) // milliseconds at the top of the Frame budget parameter
+#define MAX_RENDER_DIVIDER   4       // host frames for each rendered frame at the top of Render rate
+#define FINGERPRINT_SIZE     32      // points sampled across each input to see if it has changed
+#define TILE_SIZE            256     // pixels on each side of a tile of progressive rendering
+#define MIN_SCALE            (0.25f)
+#define MAX_SCALE            (1.0f)
+#define SCALE_HYSTERESIS     (0.1f)  // of the budget
+
+// Generic attribute of the vertex shader position.
+// 0 so that it provokes a vertex in immediate mode like glVertex.
+#define POSITION_ATTRIBUTE   (0)
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //  Plugin information
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -120,21 +192,142 @@ static CFFGLPluginInfo PluginInfo (
 );
 
 
-// Common vertex shader code as per FreeFrame examples
+// Common vertex shader code for the fullscreen triangle.
+// The position is already in clip space and gives the texture coordinate,
+// which is 0 to 1 across the viewport.
 char *vertexShaderCode = STRINGIFY (
+attribute vec2 sl_Position;
 void main()
 {
-	gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
-	gl_TexCoord[0] = gl_MultiTexCoord0;
-	gl_FrontColor = gl_Color;
+	gl_Position = vec4(sl_Position, 0.0, 1.0);
+	gl_TexCoord[0] = vec4(sl_Position*0.5 + 0.5, 0.0, 1.0);
+	gl_FrontColor = vec4(1.0);
 
 } );
 
+// The same for a core profile context, with the outputs that translated
+// shaders read in place of gl_TexCoord. The location is POSITION_ATTRIBUTE.
+const char *coreVertexShaderCode = { "#version 330 core\n"
+									 "layout(location = 0) in vec2 sl_Position;\n"
+									 "out vec4 sl_TexCoord[1];\n"
+									 "void main()\n"
+									 "{\n"
+									 "    gl_Position = vec4(sl_Position, 0.0, 1.0);\n"
+									 "    sl_TexCoord[0] = vec4(sl_Position*0.5 + 0.5, 0.0, 1.0);\n"
+									 "}\n" };
+
+// Copies a render target to the host fbo
+const char *copyShaderCode = { "uniform sampler2D sl_Source;\n"
+							   "void main()\n"
+							   "{\n"
+							   "    gl_FragColor = texture2D(sl_Source, gl_TexCoord[0].xy);\n"
+							   "}\n" };
+
+// Resolves a frame of checkerboard rendering. A pixel rendered this frame is
+// taken from sl_Current and any other from the last frame, clamped to the
+// colours of the pixels rendered around it so that movement leaves no trail.
+const char *resolveShaderCode = { "uniform sampler2D sl_Current;\n"
+								  "uniform sampler2D sl_History;\n"
+								  "uniform vec4 sl_Checkerboard;\n"
+								  "uniform vec2 sl_CurrentSize;\n"
+								  "vec4 sl_Current2D(vec2 p)\n"
+								  "{\n"
+								  "    return texture2D(sl_Current, (clamp(p, vec2(0.0), sl_CurrentSize - 1.0) + 0.5)/sl_CurrentSize);\n"
+								  "}\n"
+								  "void main()\n"
+								  "{\n"
+								  "    vec4 b = sl_Checkerboard;\n"
+								  "    vec2 q = floor(gl_FragCoord.xy);\n"
+								  "    vec2 p = floor(q/b.xy);\n"
+								  "    vec2 r = vec2(p.x*b.x + mod(b.z + p.y*(b.x - b.y), b.x), p.y*b.y + b.w);\n"
+								  "    vec4 c = sl_Current2D(p);\n"
+								  "    if(r == q) {\n"
+								  "        gl_FragColor = c;\n"
+								  "        return;\n"
+								  "    }\n"
+								  "    vec4 n0 = sl_Current2D(p + vec2(-1.0, 0.0));\n"
+								  "    vec4 n1 = sl_Current2D(p + vec2(1.0, 0.0));\n"
+								  "    vec4 n2 = sl_Current2D(p + vec2(0.0, -1.0));\n"
+								  "    vec4 n3 = sl_Current2D(p + vec2(0.0, 1.0));\n"
+								  "    vec4 lo = min(c, min(min(n0, n1), min(n2, n3)));\n"
+								  "    vec4 hi = max(c, max(max(n0, n1), max(n2, n3)));\n"
+								  "    gl_FragColor = clamp(texture2D(sl_History, gl_TexCoord[0].xy), lo, hi);\n"
+								  "}\n" };
+
+// Samples an input at a grid of points. With sl_Compare set, only the
+// points that differ from the last fingerprint in sl_History are drawn.
+const char *fingerprintShaderCode = { "uniform sampler2D sl_Source;\n"
+									  "uniform sampler2D sl_History;\n"
+									  "uniform vec2 sl_SourceScale;\n"
+									  "uniform vec2 sl_HistorySize;\n"
+									  "uniform float sl_Compare;\n"
+									  "void main()\n"
+									  "{\n"
+									  "    vec4 c = texture2D(sl_Source, gl_TexCoord[0].xy*sl_SourceScale);\n"
+									  "    vec4 h = texture2D(sl_History, gl_FragCoord.xy/sl_HistorySize);\n"
+									  "    if(sl_Compare > 0.0 && all(lessThan(abs(c - h), vec4(0.5/255.0))))\n"
+									  "        discard;\n"
+									  "    gl_FragColor = c;\n"
+									  "}\n" };
+
+// Shared by all instances in the process
+static FFGLProgramCache programCache;
+static ProgramRegistry programs(PROGRAM_LRU_COUNT, PROGRAM_LRU_MEMORY);
+static GLuint vertexShader = 0; // vertexShaderCode compiled once for every program
+static GLuint fullscreenVao = 0; // the triangle drawn by every instance, 0 without vertex array objects
+static GLuint fullscreenVbo = 0;
+static FFGLShader *copyShader = NULL;    // copyShaderCode, made when an instance first needs it
+static FFGLShader *resolveShader = NULL; // resolveShaderCode, the same
+static FFGLShader *fingerprintShader = NULL; // fingerprintShaderCode
+
+// Uniform locations of the internal shaders, found once when they are made
+enum { RESOLVE_HISTORY, RESOLVE_CHECKERBOARD, RESOLVE_CURRENTSIZE, RESOLVE_UNIFORMS };
+static const char *resolveUniforms[] = { "sl_History", "sl_Checkerboard", "sl_CurrentSize", NULL };
+static GLint resolveLocations[RESOLVE_UNIFORMS];
+enum { FINGERPRINT_HISTORY, FINGERPRINT_HISTORYSIZE, FINGERPRINT_SOURCESCALE, FINGERPRINT_COMPARE, FINGERPRINT_UNIFORMS };
+static const char *fingerprintUniforms[] = { "sl_History", "sl_HistorySize", "sl_SourceScale", "sl_Compare", NULL };
+static GLint fingerprintLocations[FINGERPRINT_UNIFORMS];
+static UniformRing globalsRing;   // ShaderGlobals blocks of all instances, which share the host context
+static TexturePool texturePool(TEXTURE_POOL_FREE, TEXTURE_POOL_KEEP);
+static FFGLFBOPool renderTargets(RENDER_TARGET_BUDGET);
+static PFNGLCOPYIMAGESUBDATAPROC copyImageSubData = NULL; // NULL without ARB_copy_image
+static int nInstances = 0;
+
+// Uniforms set by the plugin, with the names they can have in a shader
+const ShaderLoader::UniformSemantic ShaderLoader::m_semantics[] = {
+	// Time
+	{ { "time", "iGlobalTime", "iTime" },              GL_FLOAT,      &ShaderLoader::UpdateTime,              0 },
+	{ { "iTimeDelta" },                                GL_FLOAT,      &ShaderLoader::UpdateTimeDelta,         0 },
+	{ { "iFrame" },                                    GL_INT,        &ShaderLoader::UpdateFrame,             0 },
+	{ { "iDate" },                                     GL_FLOAT_VEC4, &ShaderLoader::UpdateDate,              0 },
+	{ { "iChannelTime" },                              GL_FLOAT,      &ShaderLoader::UpdateChannelTime,       0 },
+	// Resolution
+	{ { "resolution" },                                GL_FLOAT_VEC2, &ShaderLoader::UpdateScreen,            0 },
+	{ { "iResolution" },                               GL_FLOAT_VEC3, &ShaderLoader::UpdateResolution,        0 },
+	{ { "iChannelResolution" },                        GL_FLOAT_VEC3, &ShaderLoader::UpdateChannelResolution, 0 },
+	{ { "sl_ChannelScale" },                           GL_FLOAT_VEC4, &ShaderLoader::UpdateChannelScale,      0 },
+	{ { "sl_Checkerboard" },                           GL_FLOAT_VEC4, &ShaderLoader::UpdateCheckerboard,      0 },
+	// Mouse
+	{ { "mouse" },                                     GL_FLOAT_VEC2, &ShaderLoader::UpdateMouse,             0 },
+	{ { "surfaceSize" },                               GL_FLOAT_VEC2, &ShaderLoader::UpdateSurfaceSize,       0 },
+	{ { "iMouse" },                                    GL_FLOAT_VEC4, &ShaderLoader::UpdateMouseVec4,         0 },
+	// ShaderLoader extras
+	{ { "inputColour" },                               GL_FLOAT_VEC4, &ShaderLoader::UpdateInputColour,       0 },
+	// Input textures and their texture units. "texture" is
+	// renamed "sl_texture" when translated to GLSL 3.30.
+	{ { "iChannel0", "tex0", "texture", "sl_texture" }, GL_SAMPLER_2D, NULL,                                  0 },
+	{ { "iChannel1", "tex1" },                         GL_SAMPLER_2D, NULL,                                   1 },
+	{ { "iChannel2", "tex2" },                         GL_SAMPLER_2D, NULL,                                   2 },
+	{ { "iChannel3", "tex3" },                         GL_SAMPLER_2D, NULL,                                   3 },
+	// GLSL Sandbox previous frame
+	{ { "backbuffer", "bbuff" },                       GL_SAMPLER_2D, NULL,                     BACKBUFFER_UNIT },
+};
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //  Constructor and destructor
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-ShaderLoader::ShaderLoader():CFreeFrameGLPlugin(),m_initResources(1),m_inputTextureLocation(1)
+ShaderLoader::ShaderLoader():CFreeFrameGLPlugin(),m_initResources(1)
 {
 	HMODULE module;
 	char path[MAX_PATH];
@@ -148,9 +341,12 @@ ShaderLoader::ShaderLoader():CFreeFrameGLPlugin(),m_initResources(1),m_inputText
 	printf("GLSL version [%s]\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
 	_CrtSetDebugFillThreshold(0);
 
-	// Input properties allow for no texture or for two textures
+	// Input properties allow for no texture or for a texture for each ShaderToy channel
 	SetMinInputs(1);
-	SetMaxInputs(1); 
+	SetMaxInputs(4); 
+
+	// The host can supply the time instead of the performance counter
+	SetTimeSupported(true);
 	
 	// Parameters
 	SetParamInfo(FFPARAM_FILENAME,      "Shader Name",   FF_TYPE_TEXT,     "");
@@ -167,6 +363,10 @@ ShaderLoader::ShaderLoader():CFreeFrameGLPlugin(),m_initResources(1),m_inputText
 	SetParamInfo(FFPARAM_GREEN,         "Green",         FF_TYPE_STANDARD, 0.5f); m_UserGreen = 0.5f;
 	SetParamInfo(FFPARAM_BLUE,          "Blue",          FF_TYPE_STANDARD, 0.5f); m_UserBlue = 0.5f;
 	SetParamInfo(FFPARAM_ALPHA,         "Alpha",         FF_TYPE_STANDARD, 1.0f); m_UserAlpha = 1.0f;
+	SetParamInfo(FFPARAM_BUDGET,        "Frame budget",  FF_TYPE_STANDARD, 0.0f); m_UserBudget = 0.0f;
+	SetParamInfo(FFPARAM_CHECKERBOARD,  "Checkerboard",  FF_TYPE_STANDARD, 0.0f); m_UserCheckerboard = 0.0f;
+	SetParamInfo(FFPARAM_RENDERRATE,    "Render rate",   FF_TYPE_STANDARD, 0.0f); m_UserRenderRate = 0.0f;
+	SetParamInfo(FFPARAM_TILEBUDGET,    "Tile budget",   FF_TYPE_STANDARD, 0.0f); m_UserTileBudget = 0.0f;
 	
 	//SetMinInputs(1);
 
@@ -186,6 +386,25 @@ ShaderLoader::ShaderLoader():CFreeFrameGLPlugin(),m_initResources(1),m_inputText
 	bSpoutPanelOpened      = false;
 	bInitialized           = false;
 	bDialogOpen            = false;
+	bShaderPending         = false;
+
+	// Shaders
+	m_shader               = NULL;
+	m_pendingShader        = NULL;
+	m_activeShader         = NULL;
+	bGlobalsBlock          = false;
+	m_output[0]        = NULL;
+	m_output[1]        = NULL;
+	m_sparse               = NULL;
+	m_fingerprint[0]       = NULL;
+	m_fingerprint[1]       = NULL;
+	m_fingerprintQuery     = 0;
+	for(int b = 0; b < MAX_BUFFERS; b++) {
+		m_buffers[b].target[0] = m_buffers[b].target[1] = NULL;
+		m_pendingBuffers[b].target[0] = m_pendingBuffers[b].target[1] = NULL;
+		ResetBufferPass(m_buffers[b]);
+		ResetBufferPass(m_pendingBuffers[b]);
+	}
 
 	// File names
 	m_UserInput[0]         = NULL;
@@ -201,17 +420,30 @@ ShaderLoader::ShaderLoader():CFreeFrameGLPlugin(),m_initResources(1),m_inputText
 FFResult ShaderLoader::InitGL(const FFGLViewportStruct *vp)
 {
 	// initialize gl extensions and make sure required features are supported
+	// A core profile has the same calls in core, without the legacy entry points
 	m_extensions.Initialize();
-	if (m_extensions.multitexture==0 || m_extensions.ARB_shader_objects==0)
+	if (!m_extensions.CoreProfile && (m_extensions.multitexture==0 || m_extensions.ARB_shader_objects==0))
 		return FF_FAIL;
 
+	m_state.Initialize(&m_extensions);
+
+	// Input textures that have to be copied are copied without a draw if possible
+	if(FFGLExtensions::HasExtension("GL_ARB_copy_image"))
+		copyImageSubData = (PFNGLCOPYIMAGESUBDATAPROC)wglGetProcAddress("glCopyImageSubData");
+	bCopyImage = (copyImageSubData != NULL);
+
 	// Problem noted that this viewport size might not match 
-	// the viewport size in ProcessOpenGL so it is calculated later.
+	// the viewport size in ProcessOpenGL so it is checked on the first frame.
+	m_vpX      = (float)vp->x;
+	m_vpY      = (float)vp->y;
 	m_vpWidth  = (float)vp->width;
 	m_vpHeight = (float)vp->height;
+	bViewportChecked = false;
 
 	printf("InitGL - viewport (%f x %f)\n", m_vpWidth, m_vpHeight);
 
+	nInstances++;
+
 	// Start the clock
 	StartCounter();
 
@@ -220,9 +452,37 @@ FFResult ShaderLoader::InitGL(const FFGLViewportStruct *vp)
 	ReadPathFromRegistry(m_ShaderPath, "Software\\Leading Edge\\FFGLshaderloader", "Filepath");
 	bInitialized = false;
 
+	// Compiled shaders are saved so that the next load does not need to compile them
+	InitProgramCache();
+
+	// Per-frame ShaderToy globals are written to one buffer if uniform blocks are supported
+	globalsRing.Create(sizeof(ShaderGlobals), GLOBALS_RING_SLOTS);
+
+	// The shader draw is one triangle from a vertex array object if possible
+	if(fullscreenVao == 0 && (GLEE_ARB_vertex_array_object || m_extensions.CoreProfile))
+		CreateFullscreenTriangle();
+
 	return FF_SUCCESS;
 }
 
+void ShaderLoader::InitProgramCache()
+{
+	char folder[MAX_PATH];
+
+	if(programCache.IsEnabled())
+		return;
+
+	if(SHGetFolderPathA(NULL, CSIDL_LOCAL_APPDATA, NULL, 0, folder) != S_OK)
+		return;
+
+	strcat_s(folder, MAX_PATH, "\\");
+	strcat_s(folder, MAX_PATH, PROGRAM_CACHE_FOLDER);
+	SHCreateDirectoryExA(NULL, folder, NULL); // fails harmlessly if it exists
+
+	if(programCache.Initialize(folder, "ShaderLoader " PLUGIN_VERSION, PROGRAM_CACHE_SIZE))
+		printf("Program cache [%s]\n", folder);
+}
+
 ShaderLoader::~ShaderLoader()
 {
 
@@ -230,10 +490,30 @@ ShaderLoader::~ShaderLoader()
 
 FFResult ShaderLoader::DeInitGL()
 {
-	if(m_ShaderName[0] != NULL) {
-		m_shader.UnbindShader();
-		m_shader.FreeGLResources();
+	m_watcher.Stop();
+
+	// Other instances might still be using the programs
+	if(m_shader) {
+		m_shader->UnbindShader();
+		PrintUniformCounts();
+		programs.Release(m_shader);
+		m_shader = NULL;
 	}
+	ReleasePendingShaders();
+	for(int b = 0; b < MAX_BUFFERS; b++) {
+		if(m_buffers[b].shader)
+			programs.Release(m_buffers[b].shader);
+		ReleaseTargets(m_buffers[b].target, 2);
+		ResetBufferPass(m_buffers[b]);
+	}
+	ReleaseTargets(m_output, 2);
+	ReleaseTargets(&m_sparse, 1);
+	ReleaseTargets(m_fingerprint, 2);
+	if(m_fingerprintQuery)
+		glDeleteQueries(1, &m_fingerprintQuery);
+	m_fingerprintQuery = 0;
+	m_backbufferLocation = -1;
+	m_timer.Release();
 	m_ShaderName[0] = 0; // signify no shader loaded
 	
 	// Save the shader file path to the registry if it successfully initialized
@@ -245,56 +525,99 @@ FFResult ShaderLoader::DeInitGL()
 	m_UserInput[0] = 0;
 	
 	if(m_fbo) m_extensions.glDeleteFramebuffersEXT(1, &m_fbo);
-	if(m_glTexture0) glDeleteTextures(1, &m_glTexture0);
-	if(m_glTexture1) glDeleteTextures(1, &m_glTexture1);
-	if(m_glTexture2) glDeleteTextures(1, &m_glTexture2);
-	if(m_glTexture3) glDeleteTextures(1, &m_glTexture3);
-	m_glTexture0 = 0;
-	m_glTexture1 = 0;
-	m_glTexture2 = 0;
-	m_glTexture3 = 0;
+	for(int i = 0; i < 4; i++)
+		ReleaseInputTexture(i);
 	m_fbo = 0;
+	m_fboTexture = 0;
 	bInitialized = false;
 
+	// The last instance releases the shared programs while there is still a context
+	nInstances--;
+	if(nInstances <= 0) {
+		programs.Clear();
+		globalsRing.Release();
+		texturePool.Clear();
+		renderTargets.Clear();
+		if(vertexShader) glDeleteShader(vertexShader);
+		vertexShader = 0;
+		FFGLShader **internalShaders[] = { &copyShader, &resolveShader, &fingerprintShader };
+		for(int i = 0; i < sizeof(internalShaders)/sizeof(internalShaders[0]); i++) {
+			if(*internalShaders[i]) {
+				(*internalShaders[i])->FreeGLResources();
+				delete *internalShaders[i];
+				*internalShaders[i] = NULL;
+			}
+		}
+		if(fullscreenVao) glDeleteVertexArrays(1, &fullscreenVao);
+		if(fullscreenVbo) glDeleteBuffers(1, &fullscreenVbo);
+		fullscreenVao = 0;
+		fullscreenVbo = 0;
+		nInstances = 0;
+	}
+
 	return FF_SUCCESS;
 }
 
-FFResult ShaderLoader::ProcessOpenGL(ProcessOpenGLStruct *pGL)
+FFResult ShaderLoader::Resize(const FFGLViewportStruct *vp)
 {
-	FFGLTextureStruct Texture0;
-	FFGLTextureStruct Texture1;
-	FFGLTexCoords maxCoords;
-	char filename[MAX_PATH];
-	time_t datime;
-	struct tm tmbuff;
+	m_vpX      = (float)vp->x;
+	m_vpY      = (float)vp->y;
+	m_vpWidth  = (float)vp->width;
+	m_vpHeight = (float)vp->height;
+	bViewportChecked = false;
+	bRedraw = true;
 
+	return FF_SUCCESS;
+}
 
-	// Check for context loss
-	HGLRC ctx = wglGetCurrentContext();
-	if(!ctx) {
-		return  FF_FAIL;
+FFResult ShaderLoader::SetTime(double time)
+{
+	// Once the host supplies the time it is used instead of the performance counter.
+	// Start from the first time received so that the shader time does not jump.
+	if(!bHostTime) {
+		elapsedTime = time;
+		bHostTime = true;
 	}
+	m_hostTime = time;
+
+	return FF_SUCCESS;
+}
+
+FFResult ShaderLoader::ProcessOpenGL(ProcessOpenGLStruct *pGL)
+{
+	FFGLTextureStruct Texture[4]; // the host textures of the channels the shader uses
 
+	// The host hands over the context in the FFGL default state
+	m_state.Reset(pGL->HostFBO);
+
+	// Swap in a new shader if it has finished compiling
+	CheckPendingShader();
+
+	bool bCached = false;
 	if(bInitialized) {
 
 		// To the host this is an effect plugin, but it can be either a source or an effect
 		// and will work without any input, so we still start up if even there is no input texture
 
-		// Set the global viewport resolution.
-		// Get the viewport dimensions from OpenGL for certainty
-		// 14.01.15 - limited to Isadora
-		// if(strstr(m_HostName, "Isadora") != 0) {
+		// The viewport is set by InitGL and Resize. Some hosts draw to a
+		// viewport other than the one they pass, so check the one set in
+		// OpenGL on the first frame after a change.
+		if(!bViewportChecked) {
 			float vpdim[4];
 			glGetFloatv(GL_VIEWPORT, vpdim);
-		//	printf("Viewport = %dx%d (%dx%d)\n", (int)m_vpWidth, (int)m_vpHeight, (int)vpdim[2], (int)vpdim[3]);
+			if((int)vpdim[2] != (int)m_vpWidth || (int)vpdim[3] != (int)m_vpHeight)
+				printf("Viewport = %dx%d (%dx%d)\n", (int)m_vpWidth, (int)m_vpHeight, (int)vpdim[2], (int)vpdim[3]);
+			m_vpX      = vpdim[0];
+			m_vpY      = vpdim[1];
 			m_vpWidth  = vpdim[2];
 			m_vpHeight = vpdim[3];
-		// }
+			bViewportChecked = true;
+		}
 
 		/*
 		// LJ DEBUG
-		if(m_inputTextureLocation >= 0) {
-			if(m_inputTextureLocation1 >= 0)
+		if(m_inputTextureLocation[0] >= 0) {
+			if(m_inputTextureLocation[1] >= 0)
 				SetMinInputs(2);
 			else
 				SetMinInputs(1);
@@ -303,305 +626,229 @@ FFResult ShaderLoader::ProcessOpenGL(ProcessOpenGLStruct *pGL)
 			SetMinInputs(0);
 		*/
 
-		// Is there is texture needed by the shader ?
-		if(m_inputTextureLocation >= 0 || m_inputTextureLocation1 >= 0) {
-
-			// Is there a texture available ?
-			if(m_inputTextureLocation >= 0 && pGL->numInputTextures > 0 && pGL->inputTextures[0] != NULL) {
-
-				Texture0 = *(pGL->inputTextures[0]);
-				maxCoords = GetMaxGLTexCoords(Texture0);
-
-				// Delete the local texture if the incoming size is different
-				if((int)m_channelResolution[0][0] != Texture0.Width || (int)m_channelResolution[0][1] != Texture0.Height) {
-					if(m_glTexture0 > 0) glDeleteTextures(1, &m_glTexture0);
-				}
-
-				// Set the resolution of the first texture size
-				m_channelResolution[0][0] = (float)Texture0.Width;
-				m_channelResolution[0][1] = (float)Texture0.Height;
-
-				// For a power of two texture, the size will be different to the hardware size.
-				// The shader will not compensate for this, so we have to create another texture
-				// the same size as the resolution we set to the shader. Also the shader needs 
-				// textures created with wrapping REPEAT rather than CLAMP to edge
-				// So we create such a texture if the size changes and use it for every frame.
-				CreateRectangleTexture(Texture0, maxCoords, m_glTexture0, GL_TEXTURE0, m_fbo, pGL->HostFBO);
-
-				// Now we have a local texture of the right size and type
-				// Filled with the data from the incoming Freeframe texture
-			}
-
-			// Repeat if there is a second incoming texture and the shader needs it
-			if(m_inputTextureLocation1 >= 0 && pGL->numInputTextures > 1 && pGL->inputTextures[1] != NULL) {
-
-				Texture1 = *(pGL->inputTextures[1]);
-				maxCoords = GetMaxGLTexCoords(Texture1);
-
-				if((int)m_channelResolution[1][0] != Texture1.Width || (int)m_channelResolution[1][1] != Texture1.Height) {
-					if(m_glTexture1 > 0) glDeleteTextures(1, &m_glTexture1);
-				}
+		// Calculate elapsed time
+		lastTime = elapsedTime;
+		if(bHostTime)
+			elapsedTime = m_hostTime; // In seconds from the host
+		else
+			elapsedTime = GetCounter()/1000.0; // In seconds - higher resolution than timeGetTime()
+		m_timeDelta = (float)(elapsedTime-lastTime)*m_UserSpeed*2.0f; // increment scaled by user input 0.0 - 2.0
+		m_time = m_time + m_timeDelta;
 
-				// Set the channel resolution of the second texture size
-				m_channelResolution[1][0] = (float)Texture1.Width;
-				m_channelResolution[1][1] = (float)Texture1.Height;
+		// The last output is drawn again if this frame is not rendered
+		bCached = DrawCachedFrame(pGL);
+	}
 
-				CreateRectangleTexture(Texture1, maxCoords, m_glTexture1, GL_TEXTURE1, m_fbo, pGL->HostFBO);
+	if(bInitialized && !bCached) {
+
+		// With a frame budget the GPU time of the frame sets the scale of the image.
+		// With a tile budget it sets the number of tiles rendered instead, and the
+		// scale stays where it is. The result read now is for a frame a few frames ago.
+		float scale = 1.0f;
+		bool bTimed = false;
+		bool bTiled = false;
+		if((m_UserBudget > 0.0f || m_UserTileBudget > 0.0f) && (GLEE_ARB_timer_query || m_extensions.CoreProfile) && m_timer.Create()) {
+			double ms;
+			int tiles = 0;
+			bTiled = (m_UserTileBudget > 0.0f);
+			if(m_timer.GetResult(ms, &tiles)) {
+				if(bTiled)
+					m_tileScheduler.AddSample(ms, tiles);
+				else
+					m_scaler.AddSample(ms);
 			}
+			if(m_UserBudget > 0.0f)
+				scale = m_scaler.GetScale();
+			m_timer.Begin();
+			bTimed = true;
+		}
 
-			/*
-			// TODO - textures 3 and 4
-			if(m_inputTextureLocation2 >= 0 && pGL->numInputTextures > 2 && pGL->inputTextures[2] != NULL) {
-				Texture2 = *(pGL->inputTextures[2]);
-				maxCoords = GetMaxGLTexCoords(Texture2);
-				if((int)m_channelResolution[2][0] != Texture2.Width || (int)m_channelResolution[2][1] != Texture2.Height) {
-					if(m_glTexture2 > 0) glDeleteTextures(1, &m_glTexture2);
-				}
-				// Set the channel resolution of the second texture size
-				m_channelResolution[2][0] = (float)Texture2.Width;
-				m_channelResolution[2][1] = (float)Texture2.Height;
-				CreateRectangleTexture(Texture2, maxCoords, m_glTexture2, GL_TEXTURE1, m_fbo, pGL->HostFBO);
+		int width  = (int)m_vpWidth;
+		int height = (int)m_vpHeight;
+		if(scale < 1.0f) {
+			width  = MAX(1, (int)(m_vpWidth*scale + 0.5f));
+			height = MAX(1, (int)(m_vpHeight*scale + 0.5f));
+		}
+		bool bSameSize = m_output[0] && m_output[0]->GetWidth() == width && m_output[0]->GetHeight() == height;
+
+		// In tiles the image is rendered over several frames with the time it
+		// started at. It starts again if the size changes. The first image in
+		// tiles has the time delta of the frame, as m_tileTime is from before
+		// the tile budget was turned off or is not set yet.
+		if(!bTiled || !bSameSize)
+			m_tileNext = 0;
+		bool bNewImage = (m_tileNext == 0);
+		if(bTiled && bNewImage) {
+			if(!bTiledFrame)
+				m_tileTime = m_time - m_timeDelta;
+			m_tileTimeDelta = m_time - m_tileTime;
+			m_tileTime = m_time;
+		}
+		bTiledFrame = bTiled;
+
+		// The shader samples the host texture of a channel directly if it can,
+		// otherwise it is copied to a local texture.
+		for(int i = 0; i < 4; i++) {
+			Texture[i].Handle = 0;
+			if(IsInputUsed(i) && pGL->numInputTextures > (GLuint)i && pGL->inputTextures[i] != NULL) {
+				Texture[i] = *(pGL->inputTextures[i]);
+				PrepareInputTexture(Texture[i], i, pGL->HostFBO);
 			}
+		}
 
-			if(m_inputTextureLocation3 >= 0 && pGL->numInputTextures > 3 && pGL->inputTextures[3] != NULL) {
-				Texture3 = *(pGL->inputTextures[3]);
-				maxCoords = GetMaxGLTexCoords(Texture2);
-				if((int)m_channelResolution[3][0] != Texture3.Width || (int)m_channelResolution[3][1] != Texture3.Height) {
-					if(m_glTexture3 > 0) glDeleteTextures(1, &m_glTexture3);
-				}
-				// Set the channel resolution of the second texture size
-				m_channelResolution[3][0] = (float)Texture3.Width;
-				m_channelResolution[3][1] = (float)Texture3.Height;
-				CreateRectangleTexture(Texture3, maxCoords, m_glTexture3, GL_TEXTURE1, m_fbo, pGL->HostFBO);
+		// ShaderToy buffers are rendered first, each to its own render target.
+		// All the targets are made before any pass samples them, and
+		// a buffer without targets is not rendered. In tiles they are
+		// rendered once for each image.
+		bool bBuffers = false;
+		for(int b = 0; b < MAX_BUFFERS; b++) {
+			if(m_buffers[b].shader)
+				PrepareBufferTargets(m_buffers[b]);
+		}
+		for(int b = 0; b < MAX_BUFFERS; b++) {
+			if(m_buffers[b].shader && m_buffers[b].target[0] && bNewImage) {
+				RenderBuffer(m_buffers[b], Texture);
+				bBuffers = true;
 			}
-			*/
-
-		} // endif shader uses a texture
-
-		// Calculate elapsed time
-		lastTime = elapsedTime;
-		elapsedTime = GetCounter()/1000.0; // In seconds - higher resolution than timeGetTime()
-		m_time = m_time + (float)(elapsedTime-lastTime)*m_UserSpeed*2.0f; // increment scaled by user input 0.0 - 2.0
-
-		// Just pass elapsed time for individual channel times
-		m_channelTime[0] = m_time;
-		m_channelTime[1] = m_time;
-		m_channelTime[2] = m_time;
-		m_channelTime[3] = m_time;
-
-		// Calculate date vars
-		time(&datime);
-		localtime_s(&tmbuff, &datime);
-		m_dateYear = (float)tmbuff.tm_year;
-		m_dateMonth = (float)tmbuff.tm_mon+1;
-		m_dateDay = (float)tmbuff.tm_mday;
-		m_dateTime = (float)(tmbuff.tm_hour*3600 + tmbuff.tm_min*60 + tmbuff.tm_sec);
-
-		// activate our shader
-		m_shader.BindShader();
-
-		//
-		// Assign values and set the uniforms to the shader
-		//
-
-		//
-		// Common
-		//
-
-		// First input texture
-		// The shader will use the first texture bound to GL texture unit 0
-		if(m_inputTextureLocation >= 0 && Texture0.Handle > 0) {
-			m_extensions.glUniform1iARB(m_inputTextureLocation, 0);
 		}
 
-		// Second input texture
-		// The shader will use the texture bound to GL texture unit 1
-		if(m_inputTextureLocation1 >= 0 && Texture1.Handle > 0)
-			m_extensions.glUniform1iARB(m_inputTextureLocation1, 1);
-
-		/*
-		// 4 channels
-		if(m_inputTextureLocation2 >= 0 && Texture2.Handle > 0)
-			m_extensions.glUniform1iARB(m_inputTextureLocation2, 2);
-
-		if(m_inputTextureLocation3 >= 0 && Texture3.Handle > 0)
-			m_extensions.glUniform1iARB(m_inputTextureLocation3, 3);
-		*/
-
-		// Elapsed time
-		if(m_timeLocation >= 0) 
-			m_extensions.glUniform1fARB(m_timeLocation, m_time);
-	
-		//
-		// GLSL sandbox
-		//
-		// resolution (viewport size)
-		if(m_screenLocation >= 0) 
-			m_extensions.glUniform2fARB(m_screenLocation, m_vpWidth, m_vpHeight); 
-
-		// mouse - Mouse position
-		if(m_mouseLocation >= 0) { // Vec2 - normalized
-			m_mouseX = m_UserMouseX;
-			m_mouseY = m_UserMouseY;
-			m_extensions.glUniform2fARB(m_mouseLocation, m_mouseX, m_mouseY); 
+		// The image is rendered to the older of the output targets if it has
+		// a backbuffer, which is the other one, is rendered at a scale, is
+		// rendered in a checkerboard, is drawn again on the frames between
+		// those rendered or is rendered in tiles. The new frame is drawn to
+		// the host afterwards, once all of its tiles are done.
+		// A shader that does not read the time is rendered over the last
+		// frame instead, and only if its inputs have changed.
+		int checkerboard = (!bTiled && bCheckerboard && CreateInternalShader(resolveShader, resolveShaderCode, resolveUniforms, resolveLocations)) ? GetCheckerboardMode() : 0;
+		bool bMemo = bStatic && checkerboard == 0 && !bTiled;
+		GLenum outputFormat = GL_RGBA8;
+		FFGLFBO *output = NULL;
+		if((m_backbufferLocation >= 0 || scale < 1.0f || checkerboard > 0 || GetRenderDivider() > 1 || bMemo || bTiled)
+		&& PrepareTargets(m_output, 2, width, height, outputFormat))
+			output = bMemo ? m_output[0] : m_output[1];
+
+		// The draw waits on the GPU for the fingerprint of the inputs, and is
+		// dropped if they are the same as last frame. The fingerprint is kept
+		// up to date on the frames rendered anyway. Conditional rendering is in
+		// OpenGL 3.0; without it the image is rendered every frame.
+		bool bConditional = false;
+		if(output && bMemo && (GLEE_VERSION_3_0 || m_extensions.CoreProfile) && FingerprintInputs(pGL))
+			bConditional = bSameSize && !bStateChanged;
+
+		// In a checkerboard the image is rendered to a smaller target
+		// with one pixel for each block of the output
+		FFGLFBO *target = output;
+		m_checkerboard[0] = 1.0f;
+		m_checkerboard[1] = 1.0f;
+		m_checkerboard[2] = 0.0f;
+		m_checkerboard[3] = 0.0f;
+		if(output && checkerboard > 0) {
+			int blockWidth  = 2;
+			int blockHeight = (checkerboard == CHECKERBOARD_HALF) ? 1 : 2;
+			GLenum sparseFormat = GL_RGBA8;
+			if(PrepareTargets(&m_sparse, 1, (width + blockWidth - 1)/blockWidth, (height + blockHeight - 1)/blockHeight, sparseFormat)) {
+				SetCheckerboard(blockWidth, blockHeight);
+				target = m_sparse;
+			}
 		}
-
-		// surfaceSize - Mouse left drag position - in pixel coordinates
-		if(m_surfaceSizeLocation >= 0) {
-			m_mouseLeftX = m_UserMouseLeftX*m_vpWidth;
-			m_mouseLeftY = m_UserMouseLeftY*m_vpHeight;
-			m_extensions.glUniform2fARB(m_surfaceSizeLocation, m_mouseLeftX, m_mouseLeftY);
+		else if(m_sparse) {
+			ReleaseTargets(&m_sparse, 1);
 		}
 
-		//
-		// Shadertoy
-
-		// iMouse
-		// xy contain the current pixel coords (if LMB is down);
-		// zw contain the click pixel.
-		// Modified here equivalent to mouse unclicked or left button dragged
-		// The mouse is not being simulated, they are just inputs that can be used within the shader.
-		if(m_mouseLocationVec4 >= 0) {
-			// Convert from 0-1 to pixel coordinates for ShaderToy
-			// Here we use the resolution rather than the screen
-			m_mouseX     = m_UserMouseX*m_vpWidth;
-			m_mouseY     = m_UserMouseY*m_vpHeight;
-			m_mouseLeftX = m_UserMouseLeftX*m_vpWidth;
-			m_mouseLeftY = m_UserMouseLeftY*m_vpHeight;
-			m_extensions.glUniform4fARB(m_mouseLocationVec4, m_mouseX, m_mouseY, m_mouseLeftX, m_mouseLeftY); 
+		if(target) {
+			m_state.BindFramebuffer(target->GetFBOHandle());
+			glViewport(0, 0, (GLsizei)target->GetWidth(), (GLsizei)target->GetHeight());
 		}
-
-		// iResolution - viewport resolution
-		if(m_resolutionLocation >= 0) // Vec3
-			m_extensions.glUniform3fARB(m_resolutionLocation, m_vpWidth, m_vpHeight, 1.0); 
-
-		// Channel resolutions are linked to the actual texture resolutions - the size is set in ProcessOpenGL
-		// Global resolution is the viewport
-		if(m_channelresolutionLocation >= 0) {
-			// uniform vec3	iChannelResolution[4]
-			// 4 channels Vec3. Float array is 4 rows, 3 cols
-			// TODO - 4 channels - 2 & 3 are unused so will not have a texture anyway
-			m_channelResolution[2][0] = m_vpWidth;
-			m_channelResolution[2][1] = m_vpHeight;
-			m_channelResolution[2][2] = 1.0;
-			m_channelResolution[3][0] = m_vpWidth;
-			m_channelResolution[3][1] = m_vpHeight;
-			m_channelResolution[3][2] = 1.0;
-			m_extensions.glUniform3fvARB(m_channelresolutionLocation, 4, (GLfloat *)m_channelResolution);
+		else {
+			width  = (int)m_vpWidth;
+			height = (int)m_vpHeight;
+			if(bBuffers) {
+				m_state.BindFramebuffer(pGL->HostFBO);
+				glViewport((GLint)m_vpX, (GLint)m_vpY, (GLsizei)m_vpWidth, (GLsizei)m_vpHeight);
+			}
 		}
 
-		// iDate - vec4
-		if(m_dateLocation >= 0) 
-			m_extensions.glUniform4fARB(m_dateLocation, m_dateYear, m_dateMonth, m_dateDay, m_dateTime);
-
-		// Channel elapsed time - vec4
-		if(m_channeltimeLocation >= 0)
-			m_extensions.glUniform1fvARB(m_channeltimeLocation, 4, m_channelTime);
-
-		// Extras
-		// Input colour is linked to the user controls Red, Green, Blue, Alpha
-		if(m_inputColourLocation >= 0)
-			m_extensions.glUniform4fARB(m_inputColourLocation, m_UserRed, m_UserGreen, m_UserBlue, m_UserAlpha);
-
-		// Bind a texture if the shader needs one
-		if(m_inputTextureLocation >= 0 && Texture0.Handle > 0) {
-			m_extensions.glActiveTexture(GL_TEXTURE0);
-			// For a power of two texture we will have created a local texture
-			if(m_glTexture0 > 0)
-				glBindTexture(GL_TEXTURE_2D, m_glTexture0);
-			else
-				glBindTexture(GL_TEXTURE_2D, Texture0.Handle);
+		// activate our shader
+		m_activeShader = m_shader;
+		m_passWidth    = (float)width;
+		m_passHeight   = (float)height;
+		m_state.UseProgram(m_shader->GetProgram());
+
+		// Set the uniforms the shader uses and the globals block.
+		// Every tile of an image has the time the image started at.
+		float time = m_time;
+		float timeDelta = m_timeDelta;
+		if(bTiled) {
+			m_time = m_tileTime;
+			m_timeDelta = m_tileTimeDelta;
 		}
-
-		// If there is a second texture, bind it to texture unit 1
-		if(m_inputTextureLocation1 >= 0 && Texture1.Handle > 0) {
-			m_extensions.glActiveTexture(GL_TEXTURE1);
-			if(m_glTexture1 > 0)
-				glBindTexture(GL_TEXTURE_2D, m_glTexture1);
-			else
-				glBindTexture(GL_TEXTURE_2D, Texture1.Handle);
+		SetPassChannels(m_channels);
+		UpdatePassUniforms(m_uniforms, bGlobalsBlock);
+		m_time = time;
+		m_timeDelta = timeDelta;
+
+		// Bind the host texture, the local copy of it or a buffer for each channel
+		BindChannels(m_channels, m_inputTextureLocation, Texture);
+		if(m_backbufferLocation >= 0)
+			m_state.BindTexture(GL_TEXTURE0 + BACKBUFFER_UNIT, output ? m_output[0]->GetTextureHandle() : 0);
+
+		// Do the draw for the shader to work.
+		// GL_TEXTURE_2D does not need to be enabled while a shader is bound.
+		int tiles = 0;
+		if(bTiled && output) {
+			tiles = DrawTiles(width, height);
 		}
-
-		/*
-		// Texture units 2 and 3
-		if(m_inputTextureLocation2 >= 0 && Texture2.Handle > 0) {
-			m_extensions.glActiveTexture(GL_TEXTURE2);
-			if(m_glTexture2 > 0)
-				glBindTexture(GL_TEXTURE_2D, m_glTexture2);
-			else
-				glBindTexture(GL_TEXTURE_2D, Texture2.Handle);
+		else {
+			if(bConditional)
+				glBeginConditionalRender(m_fingerprintQuery, GL_QUERY_WAIT);
+			DrawFullscreenTriangle();
+			if(bConditional)
+				glEndConditionalRender();
 		}
 
-		if(m_inputTextureLocation3 >= 0 && Texture3.Handle > 0) {
-			m_extensions.glActiveTexture(GL_TEXTURE3);
-			if(m_glTexture3 > 0)
-				glBindTexture(GL_TEXTURE_2D, m_glTexture3);
-			else
-				glBindTexture(GL_TEXTURE_2D, Texture3.Handle);
+		// The pixels not rendered are filled in from the last frame
+		if(target && target == m_sparse)
+			ResolveCheckerboard(m_sparse, m_output[0], output);
+
+		// The new frame is the backbuffer of the next one, and is
+		// scaled up to the viewport by the draw to the host.
+		// Until the tiles are all done the last frame is drawn.
+		if(output) {
+			if(output == m_output[1] && m_tileNext == 0)
+				std::swap(m_output[0], m_output[1]);
+			DrawToHost(m_output[0], pGL->HostFBO);
 		}
-		*/
-		// Do the draw for the shader to work
-		glEnable(GL_TEXTURE_2D);
-		glBegin(GL_QUADS);
-		glTexCoord2f(0.0, 0.0);	
-		glVertex2f(-1.0, -1.0);
-		glTexCoord2f(0.0, 1.0);	
-		glVertex2f(-1.0,  1.0);
-		glTexCoord2f(1.0, 1.0);	
-		glVertex2f( 1.0,  1.0);
-		glTexCoord2f(1.0, 0.0);	
-		glVertex2f( 1.0, -1.0);
-		glEnd();
-		glDisable(GL_TEXTURE_2D);
 
-		/*
-		// unbind input texture 3
-		if(m_inputTextureLocation3 >= 0 && Texture3.Handle > 0) {
-			m_extensions.glActiveTexture(GL_TEXTURE3);
-			glBindTexture(GL_TEXTURE_2D, 0);
-		}
+		if(bTimed)
+			m_timer.End(tiles);
 
-		// unbind input texture 2
-		if(m_inputTextureLocation2 >= 0 && Texture2.Handle > 0) {
-			m_extensions.glActiveTexture(GL_TEXTURE2);
-			glBindTexture(GL_TEXTURE_2D, 0);
-		}
-		*/
+		if(m_tileNext == 0)
+			m_frame++;
 
-		// unbind input texture 1
-		if(m_inputTextureLocation1 >= 0 && Texture1.Handle > 0) {
-			m_extensions.glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, 0);
-		}
+	} // endif bInitialized && !bCached
 
-		// unbind input texture 0
-		m_extensions.glActiveTexture(GL_TEXTURE0); // default
-		if(m_inputTextureLocation >= 0 && Texture0.Handle > 0)
-			glBindTexture(GL_TEXTURE_2D, 0);
+	// Unbind the textures, the shader and the fbo that were changed
+	m_state.Restore();
 
-		// unbind the shader
-		m_shader.UnbindShader();
+	// Load the shader from the path read from the registry on startup.
+	// LoadShaderFile sets the name and the shader is used once it has compiled.
+	if(m_ShaderPath[0] && m_ShaderName[0] == 0)
+		LoadShaderFile(m_ShaderPath);
 
-	} // endif bInitialized
+	// Reload the shader if the file has been saved with a change
+	if(m_ShaderPath[0] && m_watcher.HasChanged()) {
+		printf("shader file changed\n");
+		LoadShaderFile(m_ShaderPath);
+	}
 
-	// Check to see if the user has selected another shader
-	if(true) {
-		
-		// Split out the file name
-		_splitpath_s(m_ShaderPath, NULL, NULL, NULL, NULL, filename, MAX_PATH, NULL, 0);
-
-		// Is it different to the current shader name ?
-		if(m_ShaderName[0] == 0 || strcmp(m_ShaderName, filename) != 0) {
-			if(LoadShaderFile(m_ShaderPath)) {
-				// Set the new shader name
-				strcpy_s(m_ShaderName, 256, filename);
-				bInitialized = true;
-			}
-			else {
-				// Same name
-				bInitialized = false;
-			}
-		}
+	// Compile the image again with or without the gl_FragCoord remap when
+	// checkerboarding is turned on or off. The current shader renders
+	// meanwhile, in full, and the program cache has either version.
+	else if(m_ShaderPath[0] && m_ShaderName[0] && bCheckerboardSource != (GetCheckerboardMode() > 0)) {
+		printf("checkerboard changed\n");
+		bCheckerboardSource = !bCheckerboardSource; // once, even if the load fails
+		LoadShaderFile(m_ShaderPath);
+		bPendingVariant = bShaderPending;
 	}
 
 	return FF_SUCCESS;
@@ -613,6 +860,11 @@ char * ShaderLoader::GetParameterDisplay(DWORD dwIndex) {
 	
 	switch (dwIndex) {
 
+		// A host can tell when a loaded shader has compiled and is in use
+		case FFPARAM_RELOAD:
+			strcpy_s(m_DisplayValue, 16, bShaderPending ? "Compiling" : "Ready");
+			return m_DisplayValue;
+
 		case FFPARAM_SPEED:
 			sprintf_s(m_DisplayValue, 16, "%d", (int)(m_UserSpeed*100.0));
 			return m_DisplayValue;
@@ -649,6 +901,34 @@ char * ShaderLoader::GetParameterDisplay(DWORD dwIndex) {
 			sprintf_s(m_DisplayValue, 16, "%d", (int)(m_UserAlpha*256.0));
 			return m_DisplayValue;
 
+		case FFPARAM_BUDGET:
+			if(m_UserBudget > 0.0f)
+				sprintf_s(m_DisplayValue, 16, "%.1f ms", m_UserBudget*MAX_FRAME_BUDGET);
+			else
+				strcpy_s(m_DisplayValue, 16, "Off");
+			return m_DisplayValue;
+
+		case FFPARAM_CHECKERBOARD:
+			{
+				static const char *modes[] = { "Off", "Half", "Quarter" };
+				strcpy_s(m_DisplayValue, 16, modes[GetCheckerboardMode()]);
+			}
+			return m_DisplayValue;
+
+		case FFPARAM_RENDERRATE:
+			if(GetRenderDivider() > 1)
+				sprintf_s(m_DisplayValue, 16, "1/%d", GetRenderDivider());
+			else
+				strcpy_s(m_DisplayValue, 16, "Every frame");
+			return m_DisplayValue;
+
+		case FFPARAM_TILEBUDGET:
+			if(m_UserTileBudget > 0.0f)
+				sprintf_s(m_DisplayValue, 16, "%.1f ms", m_UserTileBudget*MAX_FRAME_BUDGET);
+			else
+				strcpy_s(m_DisplayValue, 16, "Off");
+			return m_DisplayValue;
+
 		default:
 			return m_DisplayValue;
 	}
@@ -660,34 +940,9 @@ DWORD ShaderLoader::GetInputStatus(DWORD dwIndex)
 {
 	DWORD dwRet = FF_INPUT_NOTINUSE;
 
-	switch (dwIndex) {
-
-		case 0 :
-			if(m_inputTextureLocation >= 0)
-				dwRet = FF_INPUT_INUSE;
-			break;
-
-		case 1 :
-			if(m_inputTextureLocation1 >= 0)
-				dwRet = FF_INPUT_INUSE;
-			break;
-
-		/* TODO - 4 channels
-		case 2 :
-			if(m_inputTextureLocation2 >= 0)
-				dwRet = FF_INPUT_INUSE;
-			break;
-
-		case 3 :
-			if(m_inputTextureLocation3 >= 0)
-				dwRet = FF_INPUT_INUSE;
-			break;
-		*/
-
-		default :
-			break;
-
-	}
+	// An input is in use if the shader or a buffer samples its channel
+	if(dwIndex < 4 && IsInputUsed(dwIndex))
+		dwRet = FF_INPUT_INUSE;
 
 	return dwRet;
 
@@ -733,6 +988,22 @@ float ShaderLoader::GetFloatParameter(unsigned int dwIndex) {
 		retValue = m_UserAlpha;
 		return retValue;
 
+	case FFPARAM_BUDGET:
+		retValue = m_UserBudget;
+		return retValue;
+
+	case FFPARAM_CHECKERBOARD:
+		retValue = m_UserCheckerboard;
+		return retValue;
+
+	case FFPARAM_RENDERRATE:
+		retValue = m_UserRenderRate;
+		return retValue;
+
+	case FFPARAM_TILEBUDGET:
+		retValue = m_UserTileBudget;
+		return retValue;
+
 	default:
 		return FF_FAIL;
 	}
@@ -795,7 +1066,7 @@ FFResult ShaderLoader::SetTextParameter(unsigned int index, const char *value) {
 					//if( (m_UserShaderPath[0] > 0) && strcmp(m_UserShaderPath, m_ShaderPath) != 0){
 						strcpy_s(m_ShaderPath, MAX_PATH, m_UserShaderPath); // set global path
 						//strcpy_s(m_ShaderName, 256, filename);
-						bInitialized = LoadShaderFile(m_ShaderPath);
+						LoadShaderFile(m_ShaderPath);
 					}
 					
 				}
@@ -806,12 +1077,8 @@ FFResult ShaderLoader::SetTextParameter(unsigned int index, const char *value) {
 				m_UserShaderName[0] = 0;
 				// Try to load a shader from the global path obtained from the registry on load
 				// This is a one-off event so will not be done again
-				if (!bInitialized && m_ShaderPath[0]) {
-					if (LoadShaderFile(m_ShaderPath)) {
-					//	_splitpath_s(m_ShaderPath, NULL, NULL, NULL, NULL, filename, MAX_PATH, NULL, 0);
-					//	strcpy_s(m_ShaderName, 256, filename);
-						bInitialized = true;
-					}
+				if (!bInitialized && !bShaderPending && m_ShaderPath[0]) {
+					LoadShaderFile(m_ShaderPath);
 				}
 			}
 			return FF_SUCCESS;
@@ -825,6 +1092,11 @@ FFResult ShaderLoader::SetTextParameter(unsigned int index, const char *value) {
 }
 
 FFResult ShaderLoader::SetFloatParameter(unsigned int dwIndex, float value) {
+
+	// A change of any parameter is rendered on the next frame
+	if(value != GetFloatParameter(dwIndex))
+		bRedraw = true;
+
 	switch (dwIndex) {
 	case FFPARAM_UPDATE:
 		if (value) {
@@ -837,7 +1109,7 @@ FFResult ShaderLoader::SetFloatParameter(unsigned int dwIndex, float value) {
 				if (strcmp(m_ShaderPath, m_UserShaderPath) != 0) {
 					// Yes so load the shader file
 					strcpy_s(m_ShaderPath, MAX_PATH, m_UserShaderPath);
-					bInitialized = LoadShaderFile(m_ShaderPath); // m_ShaderName is now set by LoadShaderFile
+					LoadShaderFile(m_ShaderPath); // m_ShaderName is now set by LoadShaderFile
 				}
 			}
 		}
@@ -866,14 +1138,15 @@ FFResult ShaderLoader::SetFloatParameter(unsigned int dwIndex, float value) {
 		}
 		break;
 
-		// Reload an edited shader
+		// The file is reloaded when it is saved, but a host can still ask for it
 	case FFPARAM_RELOAD:
 		if (value) {
 			if (m_ShaderPath[0]) {
-				bInitialized = LoadShaderFile(m_ShaderPath);
+				LoadShaderFile(m_ShaderPath);
 			}
 		}
 		break;
+
 	case FFPARAM_SPEED:
 		m_UserSpeed = value;
 		break;
@@ -910,6 +1183,30 @@ FFResult ShaderLoader::SetFloatParameter(unsigned int dwIndex, float value) {
 		m_UserAlpha = value;
 		break;
 
+	case FFPARAM_BUDGET:
+		// Back to full resolution when it is turned on again
+		if(value <= 0.0f)
+			m_scaler.Reset();
+		m_scaler.SetBudget(value*MAX_FRAME_BUDGET);
+		m_UserBudget = value;
+		break;
+
+	case FFPARAM_CHECKERBOARD:
+		m_UserCheckerboard = value;
+		break;
+
+	case FFPARAM_RENDERRATE:
+		m_UserRenderRate = value;
+		break;
+
+	case FFPARAM_TILEBUDGET:
+		// Back to one tile a frame when it is turned on again
+		if(value <= 0.0f)
+			m_tileScheduler.Reset();
+		m_tileScheduler.SetBudget(value*MAX_FRAME_BUDGET);
+		m_UserTileBudget = value;
+		break;
+
 	default:
 		return FF_FAIL;
 	}
@@ -1141,342 +1438,612 @@ FFResult ShaderLoader::SetFloatParameter(unsigned int dwIndex, float value) {
 bool ShaderLoader::LoadShaderFile(const char *ShaderPath)
 {
 	std::string shaderString;
-	std::string stoyUniforms;
+	char filename[MAX_PATH];
 
 	printf("LoadShaderFile(%s)\n", ShaderPath);
 
+	// Set the shader name now so that ProcessOpenGL does not load
+	// the same file again while it is compiling or if it fails
+	_splitpath_s(ShaderPath, NULL, NULL, NULL, NULL, filename, MAX_PATH, NULL, 0);
+	strcpy_s(m_ShaderName, 256, filename);
+
 	// First check to see if the file exists
     if(_access(ShaderPath, 0) == -1) { // Mode 0 - existence check
 		// SelectSpoutPanel("Shader file not found");
 		return false;
 	}
 
-	// Open the file
-	std::ifstream sourceFile(ShaderPath);
+	// Get the shader fragment file source as a single string
+	if(!ReadShaderFile(ShaderPath, shaderString)) {
+		printf("File open error\n");
+		return false;
+	}
 
-	// Source file loaded OK ?
-	if(sourceFile.is_open()) {
-	    // Get the shader fragment file source as a single string
-		shaderString.assign( ( std::istreambuf_iterator< char >( sourceFile ) ), std::istreambuf_iterator< char >() );
-		sourceFile.close();
+	// Reload it when it is edited, even if this version is not a shader yet
+	m_watcher.Watch(ShaderPath, shaderString);
 
-		// Is it a shader file ?
-		// Look for the key string "fragColor" as well as "gl_FragColor" to allow for revised ShaderToy spec with "mainImage"
-		if(!(strstr(shaderString.c_str(), "fragColor") == 0 || strstr(shaderString.c_str(), "gl_FragColor") == 0)) {
-			SelectSpoutPanel("Not a shader file");
-			return bInitialized; // no change to the current shader
-		}
+	// Is it a shader file ?
+	// The parser finds the main function, or mainImage for the revised ShaderToy spec
+	ShaderParser parser;
+	if(!parser.Parse(shaderString)) {
+		SelectSpoutPanel("Not a shader file");
+		return false; // no change to the current shader
+	}
 
-		//
-		// Extra uniforms specific to ShaderLoader for buth GLSL Sandbox and ShaderToy
-		// TODO - extend these
-		static char *extraUniforms = { "uniform vec4 inputColour;\n" };
-		// For GLSL Sandbox, the extra "inputColour" uniform has to be typed into the shader
-		//
-		// uniform vec4 inputColour
-		//
-		
-		// Is it a GLSL Sandbox file?
-		// look for "uniform float time;". If it does not exist it is a ShaderToy file
-		// This is an exact string, so the shader has to have it.
-		if(strstr(shaderString.c_str(), "uniform float time;") == 0) {
-			//
-			// ShaderToy file
-			//
-			// Shadertoy does not include uniform variables in the source file so add them here
-			//
-			// uniform vec3			iResolution;			// the rendering resolution (in pixels)
-			// uniform float		iGlobalTime;			// current time (in seconds)
-			// uniform vec4		 	iMouse;					// xy contain the current pixel coords (if LMB is down). zw contain the click pixel.
-			// uniform vec4			iDate;					// (year, month, day, time in seconds)
-			// uniform float		iChannelTime[4];		// channel playback time (in seconds)
-			// uniform vec3			iChannelResolution[4];	// channel resolution (in pixels)
-			// uniform sampler2D	iChannel0;				// sampler for input texture 0.
-			// uniform sampler2D	iChannel1;				// sampler for input texture 1.
-			// uniform sampler2D	iChannel2;				// sampler for input texture 2.
-			// uniform sampler2D	iChannel3;				// sampler for input texture 3.
-			static char *uniforms = { "uniform vec3 iResolution;\n"
-									  "uniform float iGlobalTime;\n"
-									  "uniform vec4 iMouse;\n"
-									  "uniform vec4 iDate;\n"
-									  "uniform float iChannelTime[4];\n"
-									  "uniform vec3 iChannelResolution[4];\n"
-									  "uniform sampler2D iChannel0;\n"
-									  "uniform sampler2D iChannel1;\n"
-									  "uniform sampler2D iChannel2;\n"
-									  "uniform sampler2D iChannel3;\n" };
-			
-			stoyUniforms = uniforms;
-			stoyUniforms += extraUniforms;
-			stoyUniforms += shaderString; // add the rest of the shared content
-
-			// It might be a revised ShaderToy file with "mainImage" instead of "main"
-			if(strstr(shaderString.c_str(), "void mainImage") != 0) {
-				//
-				// If it is a revised spec ShaderToy file, add a fix at the end for GLSL compatibility
-				//
-				// Credit Eric Newman 
-				// http://magicmusicvisuals.com/forums/viewtopic.php?f=2&t=196
-				//
-				static char *stoyMainFunction = { "void main(void) {\n"
-												  "    mainImage(gl_FragColor, gl_FragCoord.xy);\n"
-												  "}\n" };
-				stoyUniforms += stoyMainFunction;
+	//
+	// ShaderToy buffers are in files next to the shader, which is the image pass.
+	// For "name.txt" they are "name_BufferA.txt" to "name_BufferD.txt", with the
+	// code of the Common tab in "name_Common.txt". The channels of a pass are
+	// host inputs unless the pass maps them to a buffer with
+	//
+	//		#pragma iChannel0 BufferA
+	//
+	// and a buffer can be given a size relative to the viewport and a format :
+	//
+	//		#pragma scale 0.5
+	//		#pragma format rgba8	(rgba16f by default, or r11g11b10f)
+	//
+	// Only the shader file itself is watched for changes.
+	//
+	std::string bufferStrings[MAX_BUFFERS];
+	ShaderParser bufferParsers[MAX_BUFFERS];
+
+	if(parser.GetDialect() == ShaderParser::DIALECT_SHADERTOY) {
+		static const char *suffixes[MAX_BUFFERS] = { "_BufferA", "_BufferB", "_BufferC", "_BufferD" };
+		char drive[_MAX_DRIVE], dir[_MAX_DIR], ext[_MAX_EXT];
+		char name[MAX_PATH], path[MAX_PATH];
+		std::string common;
+
+		_splitpath_s(ShaderPath, drive, _MAX_DRIVE, dir, _MAX_DIR, NULL, 0, ext, _MAX_EXT);
+
+		sprintf_s(name, MAX_PATH, "%s_Common", filename);
+		_makepath_s(path, MAX_PATH, drive, dir, name, ext);
+		if(ReadShaderFile(path, common))
+			InsertCommon(shaderString, parser, common);
+
+		for(int b = 0; b < MAX_BUFFERS; b++) {
+			sprintf_s(name, MAX_PATH, "%s%s", filename, suffixes[b]);
+			_makepath_s(path, MAX_PATH, drive, dir, name, ext);
+			if(!ReadShaderFile(path, bufferStrings[b]))
+				continue;
+			if(!bufferParsers[b].Parse(bufferStrings[b])) {
+				printf("%s is not a shader file\n", name);
+				bufferStrings[b].clear();
+				continue;
 			}
-
-			shaderString = stoyUniforms; // the final string
-
-		}
-	
-		// initialize gl shader
-		//m_shader.SetExtensions(&m_extensions);
-	
-
-		if (!m_shader.Compile(vertexShaderCode, shaderString.c_str())) {
-			//SelectSpoutPanel("Shader compile error");
-			return false;
-		}
-		if (!m_shader.Compile(vertexShaderCode, shaderString.c_str())) {
-			//SelectSpoutPanel("Shader compile error");
-			return false;
+			InsertCommon(bufferStrings[b], bufferParsers[b], common);
+			printf("Buffer %c [%s]\n", 'A' + b, name);
 		}
+	}
 
-		
+	return LoadShader(shaderString, parser, bufferStrings, bufferParsers);
 
-		else {
-			// activate our shader
-			bool success = false;
-			if (m_shader.IsReady()) {
-				if (m_shader.BindShader())
-					success = true;
-			}
+}
 
-			if (!success) {
-				SelectSpoutPanel("Shader bind error");
-				return false;
-			}
-			else {
-				// Set uniform locations to -1 so that they are only used if necessary
-				m_timeLocation				 = -1;
-				m_channeltimeLocation		 = -1;
-				m_mouseLocation				 = -1;
-				m_mouseLocationVec4			 = -1;
-				m_dateLocation				 = -1;
-				m_resolutionLocation		 = -1;
-				m_channelresolutionLocation  = -1;
-				m_inputTextureLocation		 = -1;
-				m_inputTextureLocation1		 = -1;
-				m_inputTextureLocation2		 = -1;
-				m_inputTextureLocation3		 = -1;
-				m_screenLocation			 = -1;
-				m_surfaceSizeLocation		 = -1;
-				// m_surfacePositionLocation	= -1; // TODO
-				// m_vertexPositionLocation    = -1; // TODO
-
-				// Extras
-				// Input colour is linked to the user controls Red, Green, Blue, Alpha
-				m_inputColourLocation        = -1;
-
-
-				// lookup the "location" of each uniform
-
-				//
-				// GLSL Sandbox
-				//
-				// Normalized mouse position. Components of this vector are always between 0.0 and 1.0.
-				//	uniform vec2 mouse;
-				// Screen (Viewport) resolution.
-				//	uniform vec2 resolution;
-				// Used for mouse left drag currently
-				//	uniform vec2 surfaceSize;
-				//  TODO uniform vec2 surfacePosition;
-
-				// Input textures do not appear to be in the GLSL Sandbox spec
-				// but are allowed for here
-
-				// From source of index.html on GitHub
-				if(m_inputTextureLocation < 0)
-					m_inputTextureLocation = m_shader.FindUniform("texture");
-
-				// Preferred names tex0 and tex1 which are commonly used
-				if(m_inputTextureLocation < 0)
-					m_inputTextureLocation = m_shader.FindUniform("tex0");
-
-				if(m_inputTextureLocation1 < 0)
-					m_inputTextureLocation1 = m_shader.FindUniform("tex1");
-
-				// TODO tex2 and tex3
-
-				// Backbuffer is not supported and is mapped to Texture unit 0
-				// From source of index.html on GitHub
-				// https://github.com/mrdoob/glsl-sandbox/blob/master/static/index.html
-				if(m_inputTextureLocation < 0)
-					m_inputTextureLocation = m_shader.FindUniform("backbuffer");
-
-				// From several sources
-				if(m_inputTextureLocation < 0)
-					m_inputTextureLocation = m_shader.FindUniform("bbuff");
-
-				// Time
-				if(m_timeLocation < 0)
-					m_timeLocation = m_shader.FindUniform("time");
-
-				// Mouse move
-				if(m_mouseLocation < 0)
-					m_mouseLocation = m_shader.FindUniform("mouse");
-
-				// Screen size
-				if(m_screenLocation < 0) // Vec2
-					m_screenLocation = m_shader.FindUniform("resolution"); 
-
-				// Mouse left drag
-				if(m_surfaceSizeLocation < 0)
-					m_surfaceSizeLocation = m_shader.FindUniform("surfaceSize");
-				
-				/*
-				// TODO
-				// surfacePosAttrib is the attribute, surfacePosition is the varying var
-				m_surfacePositionLocation = m_shader.FindAttribute("surfacePosAttrib"); 
-				if(m_surfacePositionLocation < 0) printf("surfacePosition attribute not found\n");
-				if(m_surfacePositionLocation >= 0) {
-					// enable the attribute
-					m_extensions.glEnableVertexAttribArrayARB(m_surfacePositionLocation);
-				}
-				m_vertexPositionLocation = m_shader.FindAttribute("position");
-				if(m_vertexPositionLocation < 0) printf("vertexPosition attribute not found\n");
-				if(m_vertexPositionLocation >= 0) {
-					// enable the attribute
-					m_extensions.glEnableVertexAttribArrayARB(m_vertexPositionLocation);
-				}
-				*/
+bool ShaderLoader::ReadShaderFile(const char *path, std::string &shaderString)
+{
+	shaderString.clear();
 
-				//
-				// Shadertoy
-				//
+	if(_access(path, 0) == -1)
+		return false;
 
-				
-				//
-				// Texture inputs iChannelx
-				//
-				if(m_inputTextureLocation < 0)
-					m_inputTextureLocation = m_shader.FindUniform("iChannel0");
-				
-				if(m_inputTextureLocation1 < 0)
-					m_inputTextureLocation1 = m_shader.FindUniform("iChannel1");
-
-				if(m_inputTextureLocation2 < 0)
-					m_inputTextureLocation2 = m_shader.FindUniform("iChannel2");
-
-				if(m_inputTextureLocation3 < 0)
-					m_inputTextureLocation3 = m_shader.FindUniform("iChannel3");
-
-				// iResolution
-				if(m_resolutionLocation < 0) // Vec3
-					m_resolutionLocation = m_shader.FindUniform("iResolution");
-
-				// iMouse
-				if(m_mouseLocationVec4 < 0) // Shadertoy is Vec4
-					m_mouseLocationVec4 = m_shader.FindUniform("iMouse");
-
-				// iGlobalTime
-				if(m_timeLocation < 0)
-					m_timeLocation = m_shader.FindUniform("iGlobalTime");
-
-				// iDate
-				if(m_dateLocation < 0)
-					m_dateLocation = m_shader.FindUniform("iDate");
-
-				// iChannelTime
-				if(m_channeltimeLocation < 0)
-					m_channeltimeLocation = m_shader.FindUniform("iChannelTime[4]");
-				if(m_channeltimeLocation < 0)
-					m_channeltimeLocation = m_shader.FindUniform("iChannelTime[0]");
-				if(m_channeltimeLocation < 0)
-					m_channeltimeLocation = m_shader.FindUniform("iChannelTime[1]");
-				if(m_channeltimeLocation < 0)
-					m_channeltimeLocation = m_shader.FindUniform("iChannelTime[2]");
-				if(m_channeltimeLocation < 0)
-					m_channeltimeLocation = m_shader.FindUniform("iChannelTime[3]");
-
-				// iChannelResolution
-				if(m_channelresolutionLocation < 0) // Vec3 width, height, depth * 4
-					m_channelresolutionLocation = m_shader.FindUniform("iChannelResolution[4]");
-				if(m_channelresolutionLocation < 0)
-					m_channelresolutionLocation = m_shader.FindUniform("iChannelResolution[0]");
-				if(m_channelresolutionLocation < 0)
-					m_channelresolutionLocation = m_shader.FindUniform("iChannelResolution[1]");
-				if(m_channelresolutionLocation < 0)
-					m_channelresolutionLocation = m_shader.FindUniform("iChannelResolution[2]");
-				if(m_channelresolutionLocation < 0)
-					m_channelresolutionLocation = m_shader.FindUniform("iChannelResolution[3]");
-
-				// ShaderLoader : inputColour - linked to user input
-				if(m_inputColourLocation < 0)
-					m_inputColourLocation = m_shader.FindUniform("inputColour");
-
-				m_shader.UnbindShader();
-
-				// Delete the local texture because it might be a different size
-				// Delete the local texture because it might be a different size
-				if(m_glTexture0 > 0) glDeleteTextures(1, &m_glTexture0);
-				if(m_glTexture1 > 0) glDeleteTextures(1, &m_glTexture1);
-				if(m_glTexture2 > 0) glDeleteTextures(1, &m_glTexture2);
-				if(m_glTexture3 > 0) glDeleteTextures(1, &m_glTexture3);
-				m_glTexture0 = 0;
-				m_glTexture1 = 0;
-				m_glTexture2 = 0;
-				m_glTexture3 = 0;
-
-				// Set the global path to registry because all went well
-				WritePathToRegistry(m_ShaderPath, "Software\\Leading Edge\\FFGLshaderloader", "Filepath");
-
-				// Start the clock again to start from zero
-				StartCounter();
-
-				return true;
-
-			} // bind shader OK
-		} // compile shader OK
-	} // file open OK
-	// else {
-		printf("File open error\n");
-	// }
+	std::ifstream sourceFile(path);
+	if(!sourceFile.is_open())
+		return false;
 
-	return bInitialized; // no change to the current shader
+	shaderString.assign( ( std::istreambuf_iterator< char >( sourceFile ) ), std::istreambuf_iterator< char >() );
+	sourceFile.close();
 
+	return true;
 }
 
+// The Common code goes after the #version line of a pass, which is parsed again
+void ShaderLoader::InsertCommon(std::string &shaderString, ShaderParser &parser, const std::string &common)
+{
+	if(common.empty())
+		return;
 
-void ShaderLoader::SetDefaults() {
+	shaderString.insert(parser.GetBodyStart(), common + "\n");
+	parser.Parse(shaderString);
+}
 
-	elapsedTime            = 0.0;
-	startTime              = 0.0;
-	lastTime               = 0.0;
-	PCFreq                 = 0.0;
-	CounterStart           = 0;
+//
+// Add the uniforms and main function that the shader file leaves out of the
+// fragment source of a pass. The additions are passed to the driver as separate
+// strings around the file source, so the source is not copied.
+//
+// bDirect is set for the channels sampling host inputs without a copy. If
+// bCheckerboard is true, gl_FragCoord is remapped for checkerboard rendering
+// where possible, which source.bCheckerboard is set for.
+//
+void ShaderLoader::BuildSource(const std::string &shaderString, const ShaderParser &parser, const int *channels,
+							   bool bCheckerboard, bool *bDirect, ShaderSource &source)
+{
+	const char **strings = source.strings;
+	GLint *lengths = source.lengths;
+	int count = 0;
+	std::string &header = source.header;
+	std::string &body = source.body;
+	std::string aliases;
+	bool bAnyDirect = false;
 
-	m_mouseX               = 0.5;
-	m_mouseY               = 0.5;
-	m_mouseLeftX           = 0.5;
-	m_mouseLeftY           = 0.5;
+	//
+	// ShaderToy does not include uniform variables in the source file so add them here
+	//
+	// uniform vec3			iResolution;			// the rendering resolution (in pixels)
+	// uniform float		iGlobalTime;			// current time (in seconds)
+	// uniform float		iTime;					// current time (in seconds)
+	// uniform float		iTimeDelta;				// time since the last frame (in seconds)
+	// uniform int			iFrame;					// frames since the shader was loaded
+	// uniform vec4		 	iMouse;					// xy contain the current pixel coords (if LMB is down). zw contain the click pixel.
+	// uniform vec4			iDate;					// (year, month, day, time in seconds)
+	// uniform float		iChannelTime[4];		// channel playback time (in seconds)
+	// uniform vec3			iChannelResolution[4];	// channel resolution (in pixels)
+	// uniform sampler2D	iChannel0;				// sampler for input texture 0.
+	// uniform sampler2D	iChannel1;				// sampler for input texture 1.
+	// uniform sampler2D	iChannel2;				// sampler for input texture 2.
+	// uniform sampler2D	iChannel3;				// sampler for input texture 3.
+	//
+	// Extra uniforms specific to ShaderLoader follow them.
+	// For GLSL Sandbox, the extra "inputColour" uniform has to be typed into the shader
+	//
+	// uniform vec4 inputColour
+	//
+	// Only those the shader uses and does not declare itself are added.
+	//
+	// If uniform blocks are supported, all but the samplers are members of the
+	// ShaderLoaderGlobals block and the names are defined as the members, so
+	// the shader source does not change. The block matches ShaderGlobals.
+	//
+	static const struct {
+		const char *name;
+		const char *declaration;
+		const char *alias; // NULL if not in the block
+	} stoyUniforms[] = {
+		{ "iResolution",        "uniform vec3 iResolution;\n",           "#define iResolution sl_Resolution\n" },
+		{ "iGlobalTime",        "uniform float iGlobalTime;\n",          "#define iGlobalTime sl_Time\n" },
+		{ "iTime",              "uniform float iTime;\n",                "#define iTime sl_Time\n" },
+		{ "iTimeDelta",         "uniform float iTimeDelta;\n",           "#define iTimeDelta sl_TimeDelta\n" },
+		{ "iFrame",             "uniform int iFrame;\n",                 "#define iFrame sl_Frame\n" },
+		{ "iMouse",             "uniform vec4 iMouse;\n",                "#define iMouse sl_Mouse\n" },
+		{ "iDate",              "uniform vec4 iDate;\n",                 "#define iDate sl_Date\n" },
+		{ "iChannelTime",       "uniform float iChannelTime[4];\n",      "#define iChannelTime sl_ChannelTime\n" },
+		{ "iChannelResolution", "uniform vec3 iChannelResolution[4];\n", "#define iChannelResolution sl_ChannelResolution\n" },
+		{ "iChannel0",          "uniform sampler2D iChannel0;\n",        NULL },
+		{ "iChannel1",          "uniform sampler2D iChannel1;\n",        NULL },
+		{ "iChannel2",          "uniform sampler2D iChannel2;\n",        NULL },
+		{ "iChannel3",          "uniform sampler2D iChannel3;\n",        NULL },
+		{ "inputColour",        "uniform vec4 inputColour;\n",           "#define inputColour sl_InputColour\n" },
+	};
+
+	// iChannelTime is a vec4 in the block because std140 pads float array elements to 16 bytes
+	static const char *globalsBlock = { "layout(std140) uniform ShaderLoaderGlobals {\n"
+										"    vec3 sl_Resolution;\n"
+										"    float sl_Time;\n"
+										"    vec4 sl_Mouse;\n"
+										"    vec4 sl_Date;\n"
+										"    vec4 sl_InputColour;\n"
+										"    vec4 sl_ChannelTime;\n"
+										"    vec3 sl_ChannelResolution[4];\n"
+										"    vec4 sl_ChannelScale[4];\n"
+										"    float sl_TimeDelta;\n"
+										"    int sl_Frame;\n"
+										"};\n" };
 
-	m_UserMouseX           = 0.5;
-	m_UserMouseY           = 0.5;
-	m_UserMouseLeftX       = 0.5;
-	m_UserMouseLeftY       = 0.5;
+	//
+	// For a revised spec ShaderToy file with "mainImage" instead of "main",
+	// add a fix at the end for GLSL compatibility
+	//
+	// Credit Eric Newman 
+	// http://magicmusicvisuals.com/forums/viewtopic.php?f=2&t=196
+	//
+	//
+	// Input channels sampled without a copy. Each texture call on the sampler is
+	// rewritten from "texture2D(iChannel0, uv" to "sl_Texture(iChannel0, 0, uv",
+	// which scales the coordinates to the image in the host texture and wraps
+	// them as GL_REPEAT would.
+	//
+	static const char *channelScaleUniform = { "uniform vec4 sl_ChannelScale[4];\n" };
+	static const char *channelCoordFunction = { "vec2 sl_ChannelCoord(int c, vec2 uv) {\n"
+												"    vec4 s = sl_ChannelScale[c];\n"
+												"    return clamp(fract(uv)*s.xy, s.zw, s.xy - s.zw);\n"
+												"}\n" };
 
-	m_time                 = 0.0;
-	m_dateYear             = 0.0;
-	m_dateMonth            = 0.0;
-	m_dateDay              = 0.0;
-	m_dateTime             = 0.0;
+	static const char *stoyMainFunction = { "\nvoid main(void) {\n"
+											"    mainImage(gl_FragColor, gl_FragCoord.xy);\n"
+											"}\n" };
 
-	m_channelTime[0]       = 0.0;
-	m_channelTime[1]       = 0.0;
-	m_channelTime[2]       = 0.0;
-	m_channelTime[3]       = 0.0;
+	//
+	// For checkerboard rendering the image is rendered to a target a half or a quarter
+	// of the size, and each of its pixels is one pixel of a block of the viewport. Uses of
+	// gl_FragCoord are replaced by "sl_FragCoord()", which gives the coordinate of that pixel.
+	// The blocks are 2x1 with the pixel alternating along each row, or 2x2, and the
+	// pixel in the block changes every frame. sl_Checkerboard has the block size and the
+	// pixel in the block, and (1, 1, 0, 0) gives gl_FragCoord unchanged.
+	//
+	static const char *fragCoordFunction = { "uniform vec4 sl_Checkerboard;\n"
+											 "vec4 sl_FragCoord() {\n"
+											 "    vec4 b = sl_Checkerboard;\n"
+											 "    vec2 p = floor(gl_FragCoord.xy);\n"
+											 "    return vec4(p.x*b.x + mod(b.z + p.y*(b.x - b.y), b.x) + 0.5, p.y*b.y + b.w + 0.5, gl_FragCoord.zw);\n"
+											 "}\n" };
+
+	static const char *stoyCheckerboardMainFunction = { "\nvoid main(void) {\n"
+														"    mainImage(gl_FragColor, sl_FragCoord().xy);\n"
+														"}\n" };
+
+	// Changes to the file source, in order. The replacements do not add lines,
+	// so compile errors keep their line numbers.
+	std::vector< std::pair<size_t, std::pair<size_t, std::string> > > edits;
+
+	// The #version line has to come first
+	size_t bodyStart = parser.GetBodyStart();
+
+	// A GLSL Sandbox file declares "uniform float time" and is used as it is
+	if(parser.GetDialect() == ShaderParser::DIALECT_SHADERTOY) {
+
+		for(int i = 0; i < sizeof(stoyUniforms)/sizeof(stoyUniforms[0]); i++) {
+			if(!parser.IsReferenced(stoyUniforms[i].name) || parser.IsDeclared(stoyUniforms[i].name))
+				continue;
+			if(globalsRing.IsReady() && stoyUniforms[i].alias)
+				aliases += stoyUniforms[i].alias;
+			else
+				header += stoyUniforms[i].declaration;
+		}
 
-	// ShaderToy -  Vec3 - 4 channels 
+		// A channel can be sampled directly if every reference to it,
+		// apart from a declaration, is a texture call that can be rewritten
+		const std::vector<ShaderParser::SamplerCall> &calls = parser.GetSamplerCalls();
+		for(int c = 0; c < 4; c++) {
+			char name[16];
+			int nCalls = 0;
+			sprintf_s(name, 16, "iChannel%d", c);
+			for(size_t i = 0; i < calls.size(); i++) {
+				if(calls[i].offset >= bodyStart && calls[i].sampler == name)
+					nCalls++;
+			}
+			int nUses = parser.GetReferenceCount(name) - (parser.IsDeclared(name) ? 1 : 0);
+			bDirect[c] = (channels[c] == CHANNEL_INPUT && nCalls > 0 && nCalls == nUses);
+			bAnyDirect = bAnyDirect || bDirect[c];
+		}
+
+		if(!aliases.empty() || (bAnyDirect && globalsRing.IsReady())) {
+			// Uniform blocks are core from GLSL 1.40. An #extension line has to
+			// come before any declaration, so it starts the header.
+			if(parser.GetVersion() < 140)
+				header.insert(0, "#extension GL_ARB_uniform_buffer_object : enable\n");
+			header += globalsBlock;
+			header += aliases;
+		}
+
+		if(bAnyDirect) {
+			// texture() replaces texture2D from GLSL 1.30
+			const char *lookup = (parser.GetVersion() >= 130) ? "texture" : "texture2D";
+			if(!globalsRing.IsReady())
+				header += channelScaleUniform;
+			header += channelCoordFunction;
+			header += std::string("vec4 sl_Texture(sampler2D s, int c, vec2 uv) { return ") + lookup + "(s, sl_ChannelCoord(c, uv)); }\n";
+			header += std::string("vec4 sl_Texture(sampler2D s, int c, vec2 uv, float bias) { return ") + lookup + "(s, sl_ChannelCoord(c, uv), bias); }\n";
+
+			for(size_t i = 0; i < calls.size(); i++) {
+				int c = calls[i].sampler.size() == 9 ? calls[i].sampler[8] - '0' : -1;
+				if(calls[i].offset < bodyStart || calls[i].sampler.compare(0, 8, "iChannel") != 0
+				|| c < 0 || c > 3 || !bDirect[c])
+					continue;
+				std::string call = "sl_Texture(" + calls[i].sampler + ", " + (char)('0' + c) + ",";
+				edits.push_back(std::make_pair(calls[i].offset, std::make_pair(calls[i].end, call)));
+			}
+		}
+	}
+	else {
+		for(int c = 0; c < 4; c++)
+			bDirect[c] = false;
+	}
+
+	// Every use of gl_FragCoord has to be replaced, so one in a macro rules it out
+	const std::vector<size_t> &fragCoords = parser.GetFragCoords();
+	source.bCheckerboard = (bCheckerboard && (int)fragCoords.size() == parser.GetReferenceCount("gl_FragCoord"));
+	if(source.bCheckerboard) {
+		header += fragCoordFunction;
+		for(size_t i = 0; i < fragCoords.size(); i++) {
+			if(fragCoords[i] >= bodyStart)
+				edits.push_back(std::make_pair(fragCoords[i], std::make_pair(fragCoords[i] + 12, std::string("sl_FragCoord()"))));
+		}
+		std::sort(edits.begin(), edits.end());
+	}
+
+	if(bodyStart > 0) {
+		strings[count] = shaderString.c_str();
+		lengths[count] = (GLint)bodyStart;
+		count++;
+	}
+
+	if(!header.empty()) {
+		strings[count] = header.c_str();
+		lengths[count] = (GLint)header.size();
+		count++;
+	}
+
+	if(!edits.empty()) {
+		size_t pos = bodyStart;
+		for(size_t i = 0; i < edits.size(); i++) {
+			body.append(shaderString, pos, edits[i].first - pos);
+			body += edits[i].second.second;
+			pos = edits[i].second.first;
+		}
+		body.append(shaderString, pos, std::string::npos);
+		strings[count] = body.c_str();
+		lengths[count] = (GLint)body.size();
+	}
+	else {
+		strings[count] = shaderString.c_str() + bodyStart;
+		lengths[count] = (GLint)(shaderString.size() - bodyStart);
+	}
+	count++;
+
+	// For a revised spec ShaderToy file with "mainImage" instead of "main"
+	if(parser.GetDialect() == ShaderParser::DIALECT_SHADERTOY && parser.HasMainImage() && !parser.HasMain()) {
+		strings[count] = source.bCheckerboard ? stoyCheckerboardMainFunction : stoyMainFunction;
+		lengths[count] = -1;
+		count++;
+	}
+
+	// A core profile context only compiles GLSL 3.30, so a legacy source is
+	// translated. The parts are joined to be translated as one source, with
+	// the header and the main function marked as the plugin's own text.
+	source.vertexSource = vertexShaderCode;
+	if(m_extensions.CoreProfile) {
+		std::string joined;
+		ShaderTranslator translator;
+		ShaderTranslator::Ranges injected;
+		for(int i = 0; i < count; i++) {
+			size_t length = lengths[i] < 0 ? strlen(strings[i]) : (size_t)lengths[i];
+			if(strings[i] == header.c_str() || strings[i] == stoyMainFunction || strings[i] == stoyCheckerboardMainFunction)
+				injected.push_back(std::make_pair(joined.size(), joined.size() + length));
+			joined.append(strings[i], length);
+		}
+		if(translator.Translate(joined, source.translated, &injected)) {
+			strings[0] = source.translated.c_str();
+			lengths[0] = (GLint)source.translated.size();
+			count = 1;
+		}
+		source.vertexSource = coreVertexShaderCode;
+	}
+
+	source.count = count;
+	source.key = FFGLShader::HashSource(source.vertexSource, count, strings, lengths);
+}
+
+//
+// Start compiling the image and the buffers of a shader. The current shader
+// keeps rendering until CheckPendingShader finds that all the new programs
+// have linked and swaps them in together.
+//
+bool ShaderLoader::LoadShader(const std::string &shaderString, const ShaderParser &parser,
+							  const std::string *bufferStrings, const ShaderParser *bufferParsers)
+{
+	ShaderSource image;
+	ShaderSource buffers[MAX_BUFFERS];
+	bool bBuffers[MAX_BUFFERS];
+
+	// A load that is still compiling is replaced by this one
+	ReleasePendingShaders();
+	bPendingVariant = false;
+
+	// Which buffers there are decides what a channel can sample
+	for(int b = 0; b < MAX_BUFFERS; b++)
+		bBuffers[b] = !bufferStrings[b].empty();
+
+	GetChannels(parser, bBuffers, m_pendingChannels);
+	// gl_FragCoord is remapped only while checkerboarding is on, so that
+	// other shaders keep the plain source and its cached program
+	bCheckerboardSource = (GetCheckerboardMode() > 0);
+	BuildSource(shaderString, parser, m_pendingChannels, bCheckerboardSource, bPendingChannelDirect, image);
+	bPendingCheckerboard = image.bCheckerboard;
+
+	// Whether the image reads the time is decided from the source, as the
+	// uniforms in the globals block are not in the list of uniforms
+	static const char *timeUniforms[] = { "iTime", "iGlobalTime", "iTimeDelta", "iFrame", "iDate", "iChannelTime" };
+	bPendingTimeUniform = false;
+	for(int i = 0; i < sizeof(timeUniforms)/sizeof(timeUniforms[0]); i++) {
+		if(parser.IsReferenced(timeUniforms[i]))
+			bPendingTimeUniform = true;
+	}
+
+	// How far the image can be scaled for the frame budget
+	//
+	//		#pragma minscale 0.5
+	//		#pragma maxscale 1.0
+	//		#pragma hysteresis 0.1	(of the budget)
+	//
+	std::string value;
+	m_pendingScaleBounds[0] = MIN_SCALE;
+	m_pendingScaleBounds[1] = MAX_SCALE;
+	m_pendingHysteresis     = SCALE_HYSTERESIS;
+	if(parser.GetPragma("minscale", value))
+		m_pendingScaleBounds[0] = (float)atof(value.c_str());
+	if(parser.GetPragma("maxscale", value))
+		m_pendingScaleBounds[1] = (float)atof(value.c_str());
+	if(parser.GetPragma("hysteresis", value))
+		m_pendingHysteresis = (float)atof(value.c_str());
+
+	for(int b = 0; b < MAX_BUFFERS; b++) {
+		BufferPass &pass = m_pendingBuffers[b];
+		if(!bBuffers[b])
+			continue;
+
+		GetChannels(bufferParsers[b], bBuffers, pass.channels);
+		BuildSource(bufferStrings[b], bufferParsers[b], pass.channels, false, pass.bDirect, buffers[b]);
+
+		if(bufferParsers[b].GetPragma("scale", value))
+			pass.scale = MIN(MAX((float)atof(value.c_str()), 0.0625f), 1.0f);
+		if(bufferParsers[b].GetPragma("format", value)) {
+			if(_stricmp(value.c_str(), "rgba8") == 0)
+				pass.format = GL_RGBA8;
+			else if(_stricmp(value.c_str(), "r11g11b10f") == 0)
+				pass.format = GL_R11F_G11F_B10F;
+		}
+	}
+
+	// Nothing to do if no source has changed
+	bool bUnchanged = (bInitialized && m_shader && m_shader->GetSourceKey() == image.key);
+	for(int b = 0; b < MAX_BUFFERS && bUnchanged; b++) {
+		if(bBuffers[b])
+			bUnchanged = (m_buffers[b].shader && m_buffers[b].shader->GetSourceKey() == buffers[b].key);
+		else
+			bUnchanged = (m_buffers[b].shader == NULL);
+	}
+	if(bUnchanged) {
+		ReleasePendingShaders(); // the pass settings
+		printf("shader unchanged\n");
+		return true;
+	}
+
+	m_pendingShader = AcquireProgram(image);
+	for(int b = 0; b < MAX_BUFFERS && m_pendingShader; b++) {
+		if(!bBuffers[b])
+			continue;
+		m_pendingBuffers[b].shader = AcquireProgram(buffers[b]);
+		if(!m_pendingBuffers[b].shader) {
+			ReleasePendingShaders();
+			return false;
+		}
+	}
+	if(!m_pendingShader) {
+		ReleasePendingShaders();
+		return false;
+	}
+
+	bShaderPending = true;
+
+	return true;
+}
+
+//
+// What each iChannel of a pass samples. A channel can be mapped to a buffer
+// with "#pragma iChannel0 BufferA", otherwise it is the host input.
+//
+void ShaderLoader::GetChannels(const ShaderParser &parser, const bool *bBuffers, int *channels)
+{
+	for(int c = 0; c < 4; c++) {
+		char name[16];
+		std::string value;
+
+		channels[c] = CHANNEL_INPUT;
+		sprintf_s(name, 16, "iChannel%d", c);
+		if(!parser.GetPragma(name, value))
+			continue;
+
+		if(value.size() == 7 && _strnicmp(value.c_str(), "Buffer", 6) == 0) {
+			int b = toupper((unsigned char)value[6]) - 'A';
+			if(b >= 0 && b < MAX_BUFFERS && bBuffers[b])
+				channels[c] = b;
+			else
+				printf("%s - there is no %s\n", name, value.c_str());
+		}
+	}
+}
+
+//
+// The program for a source, shared with another instance or taken from the
+// recently used programs if possible, otherwise submitted to compile.
+//
+FFGLShader *ShaderLoader::AcquireProgram(const ShaderSource &source)
+{
+	// Another instance using the same source, or a recently used program,
+	// is used from the next frame without a compile
+	FFGLShader *shader = programs.Acquire(source.key);
+	if(shader) {
+		printf("shader shared\n");
+		return shader;
+	}
+
+	// The vertex shader is the same for every program so it is only compiled once
+	if(vertexShader == 0)
+		vertexShader = FFGLShader::CreateVertexShader(source.vertexSource);
+
+	shader = new FFGLShader;
+	shader->SetProgramCache(&programCache);
+	shader->SetVertexShader(vertexShader);
+	shader->BindAttribLocation(POSITION_ATTRIBUTE, "sl_Position");
+
+	// Only submit the shader here. The driver can compile and link it in the background.
+	if(!shader->BeginCompile(source.vertexSource, source.count, source.strings, source.lengths)) {
+		printf("shader Load failed\n");
+		shader->FreeGLResources();
+		delete shader;
+		return NULL;
+	}
+
+	// Shared from now on so that other instances loading it do not compile it again
+	return programs.Add(shader);
+}
+
+void ShaderLoader::ReleasePendingShaders()
+{
+	if(m_pendingShader)
+		programs.Release(m_pendingShader);
+	m_pendingShader = NULL;
+
+	for(int b = 0; b < MAX_BUFFERS; b++) {
+		if(m_pendingBuffers[b].shader)
+			programs.Release(m_pendingBuffers[b].shader);
+		ResetBufferPass(m_pendingBuffers[b]);
+	}
+
+	bShaderPending = false;
+}
+
+// No shader and the default settings. The render targets are released first.
+void ShaderLoader::ResetBufferPass(BufferPass &pass)
+{
+	pass.shader = NULL;
+	pass.uniforms.clear();
+	pass.bGlobalsBlock = false;
+	for(int c = 0; c < 4; c++) {
+		pass.inputTextureLocation[c] = -1;
+		pass.bDirect[c] = false;
+		pass.channels[c] = CHANNEL_INPUT;
+	}
+	pass.scale = 1.0f;
+	pass.format = GL_RGBA16F;
+}
+
+
+void ShaderLoader::SetDefaults() {
+
+	elapsedTime            = 0.0;
+	startTime              = 0.0;
+	lastTime               = 0.0;
+	PCFreq                 = 0.0;
+	CounterStart           = 0;
+	m_hostTime             = 0.0;
+	bHostTime              = false;
+
+	m_mouseX               = 0.5;
+	m_mouseY               = 0.5;
+	m_mouseLeftX           = 0.5;
+	m_mouseLeftY           = 0.5;
+
+	m_UserMouseX           = 0.5;
+	m_UserMouseY           = 0.5;
+	m_UserMouseLeftX       = 0.5;
+	m_UserMouseLeftY       = 0.5;
+
+	m_time                 = 0.0;
+	m_timeDelta            = 0.0;
+	m_frame                = 0;
+	m_dateYear             = 0.0;
+	m_dateMonth            = 0.0;
+	m_dateDay              = 0.0;
+	m_dateTime             = 0.0;
+
+	m_channelTime[0]       = 0.0;
+	m_channelTime[1]       = 0.0;
+	m_channelTime[2]       = 0.0;
+	m_channelTime[3]       = 0.0;
+
+	// ShaderToy -  Vec3 - 4 channels 
 	m_channelResolution[0][0] = 0.0; // 0 is width
 	m_channelResolution[0][1] = 0.0; // 1 is height
 	m_channelResolution[0][2] = 1.0; // 2 is depth
@@ -1491,7 +2058,7 @@ void ShaderLoader::SetDefaults() {
 
 	m_channelResolution[3][0] = 0.0;
 	m_channelResolution[3][1] = 0.0;
-	m_channelResolution[4][2] = 1.0;
+	m_channelResolution[3][2] = 1.0;
 
 	m_UserSpeed               = 0.5;
 	m_UserMouseX              = 0.5;
@@ -1500,259 +2067,446 @@ void ShaderLoader::SetDefaults() {
 	m_UserMouseLeftY          = 0.5;
 
 	// OpenGL
-	m_glTexture0              = 0;
-	m_glTexture1              = 0;
-	m_glTexture2              = 0;
-	m_glTexture3              = 0;
 	m_fbo                     = 0;
+	m_fboTexture              = 0;
+	bViewportChecked          = false;
+	bCopyImage                = false;
+
+	m_vpX                     = 0.0;
+	m_vpY                     = 0.0;
+	m_passWidth               = 0.0;
+	m_passHeight              = 0.0;
+
+	for(int i = 0; i < 4; i++) {
+		m_channelScale[i][0] = 1.0;
+		m_channelScale[i][1] = 1.0;
+		m_channelScale[i][2] = 0.0;
+		m_channelScale[i][3] = 0.0;
+		m_inputResolution[i][0] = 0.0;
+		m_inputResolution[i][1] = 0.0;
+		for(int j = 0; j < 4; j++)
+			m_inputScale[i][j] = m_channelScale[i][j];
+		m_channels[i] = CHANNEL_INPUT;
+		m_pendingChannels[i] = CHANNEL_INPUT;
+		bChannelDirect[i] = false;
+		bPendingChannelDirect[i] = false;
+		m_glTexture[i] = 0;
+		m_inputTextureLocation[i] = -1;
+	}
+	m_backbufferLocation      = -1;
+	m_pendingScaleBounds[0]   = MIN_SCALE;
+	m_pendingScaleBounds[1]   = MAX_SCALE;
+	m_pendingHysteresis       = SCALE_HYSTERESIS;
+	bCheckerboard             = false;
+	bPendingCheckerboard      = false;
+	bCheckerboardSource       = false;
+	bPendingVariant           = false;
+	m_checkerboardFrame       = 0;
+	bRedraw                   = true;
+	bStateChanged             = true;
+	bStatic                   = false;
+	bPendingTimeUniform       = true;
+	m_tileNext                = 0;
+	m_tileTime                = 0.0;
+	m_tileTimeDelta           = 0.0;
+	bTiledFrame               = false;
+	m_skippedFrames           = 0;
+	m_skippedTime             = 0.0;
+	for(int i = 0; i < 4; i++) {
+		m_lastInput[i].Handle = 0;
+		m_lastInput[i].Width  = 0;
+		m_lastInput[i].Height = 0;
+	}
+	m_checkerboard[0]         = 1.0;
+	m_checkerboard[1]         = 1.0;
+	m_checkerboard[2]         = 0.0;
+	m_checkerboard[3]         = 0.0;
 
 }
 
-bool ShaderLoader::LoadShader(std::string shaderString) {
-		
-		std::string stoyUniforms;
-		//
-		// Extra uniforms specific to ShaderMaker for buth GLSL Sandbox and ShaderToy
-		// For GLSL Sandbox, the extra "inputColour" uniform has to be typed into the shader
-		//		uniform vec4 inputColour
-		static char *extraUniforms = { "uniform vec4 inputColour;\n" };
-		
-		// Is it a GLSL Sandbox file?
-		// look for "uniform float time;". If it does not exist it is a ShaderToy file
-		// This is an exact string, so the shader has to have it.
-		if(strstr(shaderString.c_str(), "uniform float time;") == 0) {
-			//
-			// ShaderToy file
-			//
-			// Shadertoy does not include uniform variables in the source file so add them here
-			//
-			// uniform vec3			iResolution;			// the rendering resolution (in pixels)
-			// uniform float		iGlobalTime;			// current time (in seconds)
-			// uniform vec4		 	iMouse;					// xy contain the current pixel coords (if LMB is down). zw contain the click pixel.
-			// uniform vec4			iDate;					// (year, month, day, time in seconds)
-			// uniform float		iChannelTime[4];		// channel playback time (in seconds)
-			// uniform vec3			iChannelResolution[4];	// channel resolution (in pixels)
-			// uniform sampler2D	iChannel0;				// sampler for input texture 0.
-			// uniform sampler2D	iChannel1;				// sampler for input texture 1.
-			// uniform sampler2D	iChannel2;				// sampler for input texture 2.
-			// uniform sampler2D	iChannel3;				// sampler for input texture 3.
-			static char *uniforms = { "uniform vec3 iResolution;\n"
-									  "uniform float iGlobalTime;\n"
-									  "uniform vec4 iMouse;\n"
-									  "uniform vec4 iDate;\n"
-									  "uniform float iChannelTime[4];\n"
-									  "uniform vec3 iChannelResolution[4];\n"
-									  "uniform sampler2D iChannel0;\n"
-									  "uniform sampler2D iChannel1;\n"
-									  "uniform sampler2D iChannel2;\n"
-									  "uniform sampler2D iChannel3;\n" };
-			
-			stoyUniforms = uniforms;
-			stoyUniforms += extraUniforms;
-			stoyUniforms += shaderString; // add the rest of the shared content
-			shaderString = stoyUniforms;
-		}
-	
-		// initialize gl shader
-	//	m_shader.SetExtensions(&m_extensions);
-		if (!m_shader.Compile(vertexShaderCode, shaderString.c_str())) {
-			// SelectSpoutPanel("Shader compile error");
+//
+// Called at the start of every frame while a shader is compiling.
+// Once the new program has linked and its uniforms are found it replaces
+// the current one, otherwise the current shader is left unchanged.
+//
+bool ShaderLoader::CheckPendingShader()
+{
+	if(!bShaderPending || !m_pendingShader->IsCompileComplete())
+		return false;
+
+	// The buffers are swapped in with the image
+	for(int b = 0; b < MAX_BUFFERS; b++) {
+		if(m_pendingBuffers[b].shader && !m_pendingBuffers[b].shader->IsCompileComplete())
 			return false;
+	}
+
+	// A shared program has already been checked by the first instance to get here
+	bool bReady = (m_pendingShader->EndCompile() && m_pendingShader->IsReady());
+	for(int b = 0; b < MAX_BUFFERS && bReady; b++) {
+		FFGLShader *shader = m_pendingBuffers[b].shader;
+		if(shader && (!shader->EndCompile() || !shader->IsReady())) {
+			printf("Buffer %c failed\n", 'A' + b);
+			bReady = false;
 		}
-		else {
-			// activate our shader
-			bool success = false;
-			if (m_shader.IsReady()) {
-				if (m_shader.BindShader())
-					success = true;
-			}
+	}
+	if(!bReady) {
+		printf("shader Load failed - keeping the current shader\n");
+		ReleasePendingShaders();
+		return false;
+	}
+	bShaderPending = false;
+
+	// The other version of the checkerboard remap of the same image carries
+	// on from the current one, with the same clock, frame count and buffers
+	bool bVariant = bPendingVariant;
+	bPendingVariant = false;
+
+	// Use the new program. The old one is kept for a quick switch back
+	// once no other instance is using it.
+	if(m_shader) {
+		PrintUniformCounts();
+		programs.Release(m_shader);
+	}
+	m_shader = m_pendingShader;
+	m_pendingShader = NULL;
+	for(int i = 0; i < 4; i++)
+		m_channels[i] = m_pendingChannels[i];
+
+	BindUniforms(m_shader, m_uniforms, m_inputTextureLocation, &m_backbufferLocation, bGlobalsBlock);
+
+	// The output targets are made again for the new shader if it needs them
+	if(!bVariant)
+		ReleaseTargets(m_output, 2);
+	ReleaseTargets(m_fingerprint, 2);
+	bCheckerboard = bPendingCheckerboard;
+
+	// A new shader starts at the largest scale it allows
+	if(!bVariant) {
+		m_scaler.SetBounds(m_pendingScaleBounds[0], m_pendingScaleBounds[1]);
+		m_scaler.SetHysteresis(m_pendingHysteresis);
+		m_scaler.Reset();
+		m_tileScheduler.Reset();
+	}
+	m_tileNext = 0;
+
+	// Save the binary and the uniform locations unless it came from the cache
+	m_shader->SaveToCache();
+
+	// The buffers of a variant are the programs already running
+	if(bVariant) {
+		for(int b = 0; b < MAX_BUFFERS; b++) {
+			if(m_pendingBuffers[b].shader)
+				programs.Release(m_pendingBuffers[b].shader);
+			ResetBufferPass(m_pendingBuffers[b]);
+		}
+	}
+
+	// The buffers start again from black, so their render targets are
+	// released and acquired again on the next frame
+	for(int b = 0; b < MAX_BUFFERS && !bVariant; b++) {
+		BufferPass &pass = m_buffers[b];
+		BufferPass &pending = m_pendingBuffers[b];
+
+		if(pass.shader)
+			programs.Release(pass.shader);
+		ReleaseTargets(pass.target, 2);
+		ResetBufferPass(pass);
+
+		if(!pending.shader)
+			continue;
+
+		pass.shader = pending.shader;
+		pass.scale  = pending.scale;
+		pass.format = pending.format;
+		for(int c = 0; c < 4; c++) {
+			pass.channels[c] = pending.channels[c];
+			pass.bDirect[c]  = pending.bDirect[c];
+		}
+		ResetBufferPass(pending);
 
-			if (!success) {
-				// SelectSpoutPanel("Shader bind error");
-				return false;
+		BindUniforms(pass.shader, pass.uniforms, pass.inputTextureLocation, NULL, pass.bGlobalsBlock);
+		pass.shader->SaveToCache();
+	}
+
+	// A host input is sampled without a copy only if every pass that
+	// samples it had its texture calls rewritten for that
+	for(int i = 0; i < 4; i++) {
+		bool bUsed = false;
+		bool bDirect = true;
+		if(m_channels[i] == CHANNEL_INPUT && m_inputTextureLocation[i] >= 0) {
+			bUsed = true;
+			bDirect = bPendingChannelDirect[i];
+		}
+		for(int b = 0; b < MAX_BUFFERS; b++) {
+			const BufferPass &pass = m_buffers[b];
+			if(pass.shader && pass.channels[i] == CHANNEL_INPUT && pass.inputTextureLocation[i] >= 0) {
+				bUsed = true;
+				bDirect = bDirect && pass.bDirect[i];
 			}
-			else {
-				// Set uniform locations to -1 so that they are only used if necessary
-				m_timeLocation				 = -1;
-				m_channeltimeLocation		 = -1;
-				m_mouseLocation				 = -1;
-				m_mouseLocationVec4			 = -1;
-				m_dateLocation				 = -1;
-				m_resolutionLocation		 = -1;
-				m_channelresolutionLocation  = -1;
-				m_inputTextureLocation		 = -1;
-				m_inputTextureLocation1		 = -1;
-				m_inputTextureLocation2		 = -1;
-				m_inputTextureLocation3		 = -1;
-				m_screenLocation			 = -1;
-				m_surfaceSizeLocation		 = -1;
-				// m_surfacePositionLocation	= -1; // TODO
-				// m_vertexPositionLocation    = -1; // TODO
-
-				// Extras
-				// Input colour is linked to the user controls Red, Green, Blue, Alpha
-				m_inputColourLocation        = -1;
-
-
-				// lookup the "location" of each uniform
-
-				//
-				// GLSL Sandbox
-				//
-				// Normalized mouse position. Components of this vector are always between 0.0 and 1.0.
-				//	uniform vec2 mouse;
-				// Screen (Viewport) resolution.
-				//	uniform vec2 resolution;
-				// Used for mouse left drag currently
-				//	uniform vec2 surfaceSize;
-				//  TODO uniform vec2 surfacePosition;
-
-				// Input textures do not appear to be in the GLSL Sandbox spec
-				// but are allowed for here
-
-				// From source of index.html on GitHub
-				if(m_inputTextureLocation < 0)
-					m_inputTextureLocation = m_shader.FindUniform("texture");
-
-				// Preferred names tex0 and tex1 which are commonly used
-				if(m_inputTextureLocation < 0)
-					m_inputTextureLocation = m_shader.FindUniform("tex0");
-
-				if(m_inputTextureLocation1 < 0)
-					m_inputTextureLocation1 = m_shader.FindUniform("tex1");
-
-				// TODO tex2 and tex3 ?
-
-				// Backbuffer is not supported and is mapped to Texture unit 0
-				// From source of index.html on GitHub
-				// https://github.com/mrdoob/glsl-sandbox/blob/master/static/index.html
-				if(m_inputTextureLocation < 0)
-					m_inputTextureLocation = m_shader.FindUniform("backbuffer");
-
-				// From several sources
-				if(m_inputTextureLocation < 0)
-					m_inputTextureLocation = m_shader.FindUniform("bbuff");
-
-				// Time
-				if(m_timeLocation < 0)
-					m_timeLocation = m_shader.FindUniform("time");
-
-				// Mouse move
-				if(m_mouseLocation < 0)
-					m_mouseLocation = m_shader.FindUniform("mouse");
-
-				// Screen size
-				if(m_screenLocation < 0) // Vec2
-					m_screenLocation = m_shader.FindUniform("resolution"); 
-
-				// Mouse left drag
-				if(m_surfaceSizeLocation < 0)
-					m_surfaceSizeLocation = m_shader.FindUniform("surfaceSize");
-				
-				/*
-				// TODO
-				// surfacePosAttrib is the attribute, surfacePosition is the varying var
-				m_surfacePositionLocation = m_shader.FindAttribute("surfacePosAttrib"); 
-				if(m_surfacePositionLocation < 0) printf("surfacePosition attribute not found\n");
-				if(m_surfacePositionLocation >= 0) {
-					// enable the attribute
-					m_extensions.glEnableVertexAttribArrayARB(m_surfacePositionLocation);
-				}
-				m_vertexPositionLocation = m_shader.FindAttribute("position");
-				if(m_vertexPositionLocation < 0) printf("vertexPosition attribute not found\n");
-				if(m_vertexPositionLocation >= 0) {
-					// enable the attribute
-					m_extensions.glEnableVertexAttribArrayARB(m_vertexPositionLocation);
-				}
-				*/
+		}
+		bChannelDirect[i] = (bUsed && bDirect);
+	}
 
-				//
-				// Shadertoy
-				//
+	// The image is only rendered again on a change if it does not read the time
+	bStatic = IsStaticShader();
 
-				
-				//
-				// Texture inputs iChannelx
-				//
-				if(m_inputTextureLocation < 0)
-					m_inputTextureLocation = m_shader.FindUniform("iChannel0");
-				if(m_inputTextureLocation1 < 0)
-					m_inputTextureLocation1 = m_shader.FindUniform("iChannel1");
-				if(m_inputTextureLocation2 < 0)
-					m_inputTextureLocation2 = m_shader.FindUniform("iChannel2");
-				if(m_inputTextureLocation3 < 0)
-					m_inputTextureLocation3 = m_shader.FindUniform("iChannel3");
-
-				// iResolution
-				if(m_resolutionLocation < 0) // Vec3
-					m_resolutionLocation = m_shader.FindUniform("iResolution");
-
-				// iMouse
-				if(m_mouseLocationVec4 < 0) // Shadertoy is Vec4
-					m_mouseLocationVec4 = m_shader.FindUniform("iMouse");
-
-				// iGlobalTime
-				if(m_timeLocation < 0)
-					m_timeLocation = m_shader.FindUniform("iGlobalTime");
-
-				// iDate
-				if(m_dateLocation < 0)
-					m_dateLocation = m_shader.FindUniform("iDate");
-
-				// iChannelTime
-				if(m_channeltimeLocation < 0)
-					m_channeltimeLocation = m_shader.FindUniform("iChannelTime[4]");
-				if(m_channeltimeLocation < 0)
-					m_channeltimeLocation = m_shader.FindUniform("iChannelTime[0]");
-				if(m_channeltimeLocation < 0)
-					m_channeltimeLocation = m_shader.FindUniform("iChannelTime[1]");
-				if(m_channeltimeLocation < 0)
-					m_channeltimeLocation = m_shader.FindUniform("iChannelTime[2]");
-				if(m_channeltimeLocation < 0)
-					m_channeltimeLocation = m_shader.FindUniform("iChannelTime[3]");
-
-				// iChannelResolution
-				if(m_channelresolutionLocation < 0) // Vec3 width, height, depth * 4
-					m_channelresolutionLocation = m_shader.FindUniform("iChannelResolution[4]");
-				if(m_channelresolutionLocation < 0)
-					m_channelresolutionLocation = m_shader.FindUniform("iChannelResolution[0]");
-				if(m_channelresolutionLocation < 0)
-					m_channelresolutionLocation = m_shader.FindUniform("iChannelResolution[1]");
-				if(m_channelresolutionLocation < 0)
-					m_channelresolutionLocation = m_shader.FindUniform("iChannelResolution[2]");
-				if(m_channelresolutionLocation < 0)
-					m_channelresolutionLocation = m_shader.FindUniform("iChannelResolution[3]");
-
-				// inputColour - linked to user input
-				if(m_inputColourLocation < 0)
-					m_inputColourLocation = m_shader.FindUniform("inputColour");
-
-				m_shader.UnbindShader();
-
-				// Delete the local texture because it might be a different size
-				if(m_glTexture0 > 0) glDeleteTextures(1, &m_glTexture0);
-				if(m_glTexture1 > 0) glDeleteTextures(1, &m_glTexture1);
-				if(m_glTexture2 > 0) glDeleteTextures(1, &m_glTexture2);
-				if(m_glTexture3 > 0) glDeleteTextures(1, &m_glTexture3);
-				m_glTexture0 = 0;
-				m_glTexture1 = 0;
-				m_glTexture2 = 0;
-				m_glTexture3 = 0;
-
-				// Start the clock again to start from zero
-				StartCounter();
-
-				printf("shader Loaded OK\n");
-
-				return true;
-
-			} // bind shader OK
-		} // compile shader OK
-		// =============================================
+	// Local textures are kept while the input size is the same, so
+	// only those for channels the new shader does not use are released
+	for(int i = 0; i < 4; i++) {
+		if(!IsInputUsed(i))
+			ReleaseInputTexture(i);
+	}
 
-		printf("shader Load failed\n");
+	// Set the global path to registry because all went well
+	WritePathToRegistry(m_ShaderPath, "Software\\Leading Edge\\FFGLshaderloader", "Filepath");
 
-		return false;
+	// Start the clock again to start from zero
+	if(!bVariant) {
+		StartCounter();
+		m_frame = 0;
+	}
+
+	bInitialized = true;
+
+	printf("shader Loaded OK\n");
+
+	return true;
+}
+
+//
+// Match the active uniforms of the shader of a pass with the semantic table. Samplers
+// are set to their texture unit here and the rest are updated every frame.
+//
+void ShaderLoader::BindUniforms(FFGLShader *shader, std::vector<BoundUniform> &uniforms, GLint *inputTextureLocation,
+								GLint *backbufferLocation, bool &bGlobals)
+{
+	std::vector<FFGLActiveUniform> active;
+
+	uniforms.clear();
+	for(int i = 0; i < 4; i++)
+		inputTextureLocation[i] = -1;
+	if(backbufferLocation)
+		*backbufferLocation = -1;
+
+	shader->GetActiveUniforms(active);
+
+	// Samplers are set here, which needs the program bound unless uniforms can be set directly
+	// The program is left bound for the draw and unbound at the end of the frame.
+	if(!GLEE_ARB_separate_shader_objects)
+		m_state.UseProgram(shader->GetProgram());
+
+	// The block members are not in the active uniforms with a location
+	bGlobals = (globalsRing.IsReady() && shader->BindUniformBlock("ShaderLoaderGlobals", GLOBALS_BINDING));
+
+	for(size_t i = 0; i < active.size(); i++) {
+		const UniformSemantic *semantic = FindSemantic(active[i].name.c_str());
+		if(!semantic)
+			continue; // set by the shader author, not by us
+
+		if(semantic->type != active[i].type) {
+			printf("uniform %s is not the type expected\n", active[i].name.c_str());
+			continue;
+		}
+
+		if(semantic->update) {
+			BoundUniform uniform;
+			uniform.location = active[i].location;
+			uniform.size     = active[i].size;
+			uniform.update   = semantic->update;
+			uniforms.push_back(uniform);
+		}
+		else if(semantic->textureUnit == BACKBUFFER_UNIT) {
+			// Only the image has a backbuffer. A ShaderToy buffer samples its own previous frame instead.
+			if(!backbufferLocation)
+				continue;
+			shader->SetUniform1i(active[i].location, BACKBUFFER_UNIT);
+			*backbufferLocation = active[i].location;
+		}
+		else {
+			// An input texture on its own texture unit
+			shader->SetUniform1i(active[i].location, semantic->textureUnit);
+			inputTextureLocation[semantic->textureUnit] = active[i].location;
+		}
+	}
+}
+
+const ShaderLoader::UniformSemantic *ShaderLoader::FindSemantic(const char *name)
+{
+	for(int i = 0; i < sizeof(m_semantics)/sizeof(m_semantics[0]); i++) {
+		for(int j = 0; j < MAX_SEMANTIC_NAMES && m_semantics[i].names[j]; j++) {
+			if(strcmp(m_semantics[i].names[j], name) == 0)
+				return &m_semantics[i];
+		}
+	}
+	return NULL;
+}
+
+//
+// Uniform updates called every frame while the shader is bound
+//
+
+void ShaderLoader::UpdateTime(GLint location, GLint size)
+{
+	m_activeShader->SetUniform1f(location, m_time);
+}
+
+void ShaderLoader::UpdateTimeDelta(GLint location, GLint size)
+{
+	m_activeShader->SetUniform1f(location, m_timeDelta);
+}
+
+void ShaderLoader::UpdateFrame(GLint location, GLint size)
+{
+	m_activeShader->SetUniform1i(location, m_frame);
+}
+
+// GLSL Sandbox resolution (viewport size)
+void ShaderLoader::UpdateScreen(GLint location, GLint size)
+{
+	m_activeShader->SetUniform2f(location, m_passWidth, m_passHeight);
+}
+
+// ShaderToy iResolution - viewport resolution
+void ShaderLoader::UpdateResolution(GLint location, GLint size)
+{
+	m_activeShader->SetUniform3f(location, m_passWidth, m_passHeight, 1.0);
+}
+
+// GLSL Sandbox mouse - normalized
+void ShaderLoader::UpdateMouse(GLint location, GLint size)
+{
+	m_mouseX = m_UserMouseX;
+	m_mouseY = m_UserMouseY;
+	m_activeShader->SetUniform2f(location, m_mouseX, m_mouseY);
+}
+
+// GLSL Sandbox surfaceSize - Mouse left drag position - in pixel coordinates
+void ShaderLoader::UpdateSurfaceSize(GLint location, GLint size)
+{
+	m_mouseLeftX = m_UserMouseLeftX*m_passWidth;
+	m_mouseLeftY = m_UserMouseLeftY*m_passHeight;
+	m_activeShader->SetUniform2f(location, m_mouseLeftX, m_mouseLeftY);
+}
+
+// ShaderToy iMouse
+// xy contain the current pixel coords (if LMB is down);
+// zw contain the click pixel.
+// Modified here equivalent to mouse unclicked or left button dragged
+// The mouse is not being simulated, they are just inputs that can be used within the shader.
+void ShaderLoader::UpdateMouseVec4(GLint location, GLint size)
+{
+	// Convert from 0-1 to pixel coordinates for ShaderToy
+	// Here we use the resolution rather than the screen
+	m_mouseX     = m_UserMouseX*m_passWidth;
+	m_mouseY     = m_UserMouseY*m_passHeight;
+	m_mouseLeftX = m_UserMouseLeftX*m_passWidth;
+	m_mouseLeftY = m_UserMouseLeftY*m_passHeight;
+	m_activeShader->SetUniform4f(location, m_mouseX, m_mouseY, m_mouseLeftX, m_mouseLeftY);
+}
+
+// ShaderToy iDate - year, month, day, time in seconds
+void ShaderLoader::UpdateDate(GLint location, GLint size)
+{
+	CalculateDate();
+	m_activeShader->SetUniform4f(location, m_dateYear, m_dateMonth, m_dateDay, m_dateTime);
+}
+
+void ShaderLoader::CalculateDate()
+{
+	time_t datime;
+	struct tm tmbuff;
+
+	time(&datime);
+	localtime_s(&tmbuff, &datime);
+	m_dateYear = (float)tmbuff.tm_year;
+	m_dateMonth = (float)tmbuff.tm_mon+1;
+	m_dateDay = (float)tmbuff.tm_mday;
+	m_dateTime = (float)(tmbuff.tm_hour*3600 + tmbuff.tm_min*60 + tmbuff.tm_sec);
+}
+
+// ShaderToy iChannelTime[4] - just pass elapsed time for individual channel times
+void ShaderLoader::UpdateChannelTime(GLint location, GLint size)
+{
+	m_channelTime[0] = m_time;
+	m_channelTime[1] = m_time;
+	m_channelTime[2] = m_time;
+	m_channelTime[3] = m_time;
+	m_activeShader->SetUniform1fv(location, MIN(size, 4), m_channelTime);
+}
+
+// ShaderToy iChannelResolution[4]
+// Channel resolutions are linked to the actual texture resolutions - the size is set in ProcessOpenGL
+// Global resolution is the viewport
+void ShaderLoader::UpdateChannelResolution(GLint location, GLint size)
+{
+	// 4 channels Vec3. Float array is 4 rows, 3 cols
+	m_activeShader->SetUniform3fv(location, MIN(size, 4), (GLfloat *)m_channelResolution);
+}
+
+void ShaderLoader::UpdateChannelScale(GLint location, GLint size)
+{
+	m_activeShader->SetUniform4fv(location, MIN(size, 4), (GLfloat *)m_channelScale);
+}
+
+// The block size and the pixel rendered in each block for the gl_FragCoord remapping
+void ShaderLoader::UpdateCheckerboard(GLint location, GLint size)
+{
+	m_activeShader->SetUniform4fv(location, 1, m_checkerboard);
+}
+
+// ShaderLoader extra - input colour is linked to the user controls Red, Green, Blue, Alpha
+void ShaderLoader::UpdateInputColour(GLint location, GLint size)
+{
+	m_activeShader->SetUniform4f(location, m_UserRed, m_UserGreen, m_UserBlue, m_UserAlpha);
+}
+
+// Uploads made and skipped because the program already had the value,
+// counted for the program since it was linked
+void ShaderLoader::PrintUniformCounts()
+{
+	unsigned int uploaded = 0;
+	unsigned int skipped = 0;
+
+	m_shader->GetUniformCounts(uploaded, skipped);
+	printf("uniforms - %u uploaded, %u skipped\n", uploaded, skipped);
+}
+
+// All the ShaderToy globals in one block, written to the next slot of the ring
+void ShaderLoader::UpdateGlobals()
+{
+	ShaderGlobals globals;
+
+	CalculateDate();
+
+	globals.resolution[0]  = m_passWidth;
+	globals.resolution[1]  = m_passHeight;
+	globals.resolution[2]  = 1.0;
+	globals.time           = m_time;
+	globals.mouse[0]       = m_UserMouseX*m_passWidth;
+	globals.mouse[1]       = m_UserMouseY*m_passHeight;
+	globals.mouse[2]       = m_UserMouseLeftX*m_passWidth;
+	globals.mouse[3]       = m_UserMouseLeftY*m_passHeight;
+	globals.date[0]        = m_dateYear;
+	globals.date[1]        = m_dateMonth;
+	globals.date[2]        = m_dateDay;
+	globals.date[3]        = m_dateTime;
+	globals.inputColour[0] = m_UserRed;
+	globals.inputColour[1] = m_UserGreen;
+	globals.inputColour[2] = m_UserBlue;
+	globals.inputColour[3] = m_UserAlpha;
+	for(int i = 0; i < 4; i++) {
+		globals.channelTime[i] = m_time;
+		globals.channelResolution[i][0] = m_channelResolution[i][0];
+		globals.channelResolution[i][1] = m_channelResolution[i][1];
+		globals.channelResolution[i][2] = 1.0;
+		globals.channelResolution[i][3] = 0.0;
+		for(int j = 0; j < 4; j++)
+			globals.channelScale[i][j] = m_channelScale[i][j];
+	}
+	globals.timeDelta      = m_timeDelta;
+	globals.frame          = m_frame;
+
+	globalsRing.Bind(GLOBALS_BINDING, &globals);
 }
 
 bool ShaderLoader::WritePathToRegistry(const char *filepath, const char *subkey, const char *valuename)
@@ -1822,6 +2576,13 @@ void ShaderLoader::StartCounter()
     QueryPerformanceCounter(&li);
     CounterStart = li.QuadPart;
 
+	// The elapsed time is read from the counter unless the host supplies it,
+	// so it starts again with it and the next time delta is not negative
+	if(!bHostTime) {
+		elapsedTime = 0.0;
+		lastTime    = 0.0;
+	}
+
 }
 
 double ShaderLoader::GetCounter()
@@ -2054,9 +2815,597 @@ bool ShaderLoader::CheckSpoutPanel()
 		return bRet;
 } // ========= END USER SELECTION PANEL =====
 
+//
+// Set up an input texture for a channel. If every use of the channel sampler is a
+// texture call that LoadShader has rewritten, the shader samples the host texture
+// and the coordinates are scaled to the part of it with the image, and wrapped.
+// Otherwise the shader expects a texture the size of the image that repeats, so
+// the image is copied to a local texture which is kept while the size is the same.
+//
+void ShaderLoader::PrepareInputTexture(const FFGLTextureStruct &Texture, int channel, GLuint hostFbo)
+{
+	// Give the local texture back to the pool if the incoming size
+	// is different or if it is not needed any more
+	if(bChannelDirect[channel]
+	|| (int)m_inputResolution[channel][0] != Texture.Width
+	|| (int)m_inputResolution[channel][1] != Texture.Height)
+		ReleaseInputTexture(channel);
+
+	m_inputResolution[channel][0] = (float)Texture.Width;
+	m_inputResolution[channel][1] = (float)Texture.Height;
+
+	if(bChannelDirect[channel]) {
+		// Keep half a texel inside the image so that linear filtering does not reach the padding
+		m_inputScale[channel][0] = (float)Texture.Width/(float)Texture.HardwareWidth;
+		m_inputScale[channel][1] = (float)Texture.Height/(float)Texture.HardwareHeight;
+		m_inputScale[channel][2] = 0.5f/(float)Texture.HardwareWidth;
+		m_inputScale[channel][3] = 0.5f/(float)Texture.HardwareHeight;
+		return;
+	}
+
+	// A pass with rewritten texture calls can still sample the copy
+	m_inputScale[channel][0] = 1.0f;
+	m_inputScale[channel][1] = 1.0f;
+	m_inputScale[channel][2] = 0.5f/(float)Texture.Width;
+	m_inputScale[channel][3] = 0.5f/(float)Texture.Height;
+
+	CopyInputTexture(Texture, m_glTexture[channel], hostFbo);
+}
+
+// True if the image or a buffer samples the host input of a channel
+bool ShaderLoader::IsInputUsed(int channel)
+{
+	if(m_channels[channel] == CHANNEL_INPUT && m_inputTextureLocation[channel] >= 0)
+		return true;
+
+	for(int b = 0; b < MAX_BUFFERS; b++) {
+		const BufferPass &pass = m_buffers[b];
+		if(pass.shader && pass.channels[channel] == CHANNEL_INPUT && pass.inputTextureLocation[channel] >= 0)
+			return true;
+	}
+
+	return false;
+}
+
+void ShaderLoader::ReleaseInputTexture(int channel)
+{
+	if(m_glTexture[channel] == 0)
+		return;
+
+	texturePool.Release(m_glTexture[channel]);
+	if(m_fboTexture == m_glTexture[channel])
+		m_fboTexture = 0; // it can be deleted and the name used again
+	m_glTexture[channel] = 0;
+}
+
+//
+// Copy the image part of a host texture to a local texture the same size with repeat wrapping.
+// glCopyImageSubData copies without the fbo. Failing that, glBlitFramebuffer copies from the
+// host texture on the first colour attachment of the fbo to the local one on the second.
+// A quad is drawn if neither is supported.
+//
+void ShaderLoader::CopyInputTexture(const FFGLTextureStruct &Texture, GLuint &glTexture, GLuint hostFbo)
+{
+	bool bCreated = false;
+
+	if(glTexture == 0) {
+		// glCopyImageSubData needs a format the same size as the host texture
+		GLint format = GL_RGBA;
+		if(bCopyImage) {
+			m_state.BindTexture(GL_TEXTURE0, Texture.Handle);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+		}
+		glTexture = texturePool.Acquire(m_state, Texture.Width, Texture.Height, format);
+		bCreated = true;
+	}
+
+	if(bCopyImage) {
+		if(bCreated)
+			glGetError(); // clear any earlier error to check the first copy
+		copyImageSubData(Texture.Handle, GL_TEXTURE_2D, 0, 0, 0, 0,
+						 glTexture, GL_TEXTURE_2D, 0, 0, 0, 0,
+						 Texture.Width, Texture.Height, 1);
+		// The driver rejects a host texture that is not complete or has an incompatible format
+		if(!bCreated || glGetError() == GL_NO_ERROR)
+			return;
+		printf("glCopyImageSubData failed - using glBlitFramebuffer\n");
+		bCopyImage = false;
+	}
+
+	if(!GLEE_EXT_framebuffer_blit && !m_extensions.CoreProfile) {
+		CreateRectangleTexture(Texture, GetMaxGLTexCoords(Texture), glTexture, GL_TEXTURE0, m_fbo, hostFbo);
+		return;
+	}
+
+	if(m_fbo == 0) {
+		m_extensions.glGenFramebuffersEXT(1, &m_fbo);
+		m_state.BindFramebuffer(m_fbo);
+		glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
+		glDrawBuffer(GL_COLOR_ATTACHMENT1_EXT);
+	}
+	m_state.BindFramebuffer(m_fbo);
+
+	// The host texture can be a new one with the same name, so it is always attached
+	m_extensions.glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, Texture.Handle, 0);
+	if(m_fboTexture != glTexture) {
+		m_extensions.glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT1_EXT, GL_TEXTURE_2D, glTexture, 0);
+		m_fboTexture = glTexture;
+	}
+
+	// The EXT entry point is not exported by a core profile
+	if(m_extensions.CoreProfile)
+		glBlitFramebuffer(0, 0, Texture.Width, Texture.Height,
+						  0, 0, Texture.Width, Texture.Height,
+						  GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	else
+		glBlitFramebufferEXT(0, 0, Texture.Width, Texture.Height,
+							 0, 0, Texture.Width, Texture.Height,
+							 GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+	m_state.BindFramebuffer(hostFbo);
+}
+
 // NPOTS textures support only the GL_CLAMP, GL_CLAMP_TO_EDGE, and GL_CLAMP_TO_BORDER wrap modes ??
 // Seems OK with this.
 
+//
+// Get a pair of render targets from the pool. They are kept while the size and
+// format are the same and cleared to black when they are new. A float format
+// falls back to GL_RGBA8, and if the pool has no room for both there are none.
+//
+bool ShaderLoader::PrepareTargets(FFGLFBO **targets, int count, int width, int height, GLenum &format)
+{
+	bool bCreated = false;
+
+	for(int i = 0; i < count; i++) {
+		FFGLFBO *target = targets[i];
+		if(target && ((int)target->GetWidth() != width || (int)target->GetHeight() != height
+		|| target->GetPixelFormat() != format)) {
+			renderTargets.Release(target);
+			targets[i] = NULL;
+		}
+	}
+
+	bool bComplete = true;
+	for(int i = 0; i < count; i++) {
+		if(!targets[i]) {
+			targets[i] = renderTargets.Acquire(width, height, format, 0);
+			bCreated = true;
+		}
+		bComplete = bComplete && targets[i];
+	}
+
+	// Not every driver renders to float formats, and 8 bit targets also take less of the budget
+	if(!bComplete && format != GL_RGBA8) {
+		printf("Render target format %x failed - using GL_RGBA8\n", format);
+		ReleaseTargets(targets, count);
+		format = GL_RGBA8;
+		bComplete = true;
+		for(int i = 0; i < count; i++) {
+			targets[i] = renderTargets.Acquire(width, height, format, 0);
+			bComplete = bComplete && targets[i];
+		}
+	}
+
+	// Creating a render target changes the bindings
+	if(bCreated)
+		m_state.Invalidate();
+
+	if(!bComplete) {
+		ReleaseTargets(targets, count);
+		return false;
+	}
+
+	if(bCreated) {
+		GLfloat clearColor[4];
+		glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		for(int i = 0; i < count; i++) {
+			m_state.BindFramebuffer(targets[i]->GetFBOHandle());
+			glClear(GL_COLOR_BUFFER_BIT);
+		}
+		glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+	}
+
+	return true;
+}
+
+void ShaderLoader::ReleaseTargets(FFGLFBO **targets, int count)
+{
+	for(int i = 0; i < count; i++) {
+		if(targets[i])
+			renderTargets.Release(targets[i]);
+		targets[i] = NULL;
+	}
+}
+
+// The targets of a buffer are the scaled viewport size.
+// If the pool has no room for them, the buffer is not rendered.
+void ShaderLoader::PrepareBufferTargets(BufferPass &pass)
+{
+	int width  = MAX(1, (int)(m_vpWidth*pass.scale + 0.5f));
+	int height = MAX(1, (int)(m_vpHeight*pass.scale + 0.5f));
+
+	PrepareTargets(pass.target, 2, width, height, pass.format);
+}
+
+//
+// A program of the plugin drawn with the fullscreen triangle, shared by all instances.
+// copyShader draws a render target to the host fbo. A draw works with any host fbo,
+// where a blit fails if it is multisampled. The locations of the uniforms named in
+// the NULL terminated list are found once the shader has compiled.
+//
+bool ShaderLoader::CreateInternalShader(FFGLShader *&shader, const char *code, const char **uniforms, GLint *locations)
+{
+	const char *vertexSource = vertexShaderCode;
+	std::string source = code;
+	std::string translated;
+
+	if(shader)
+		return shader->IsReady() != 0;
+
+	if(m_extensions.CoreProfile) {
+		ShaderTranslator translator;
+		ShaderTranslator::Ranges injected(1, std::make_pair((size_t)0, source.size()));
+		if(translator.Translate(source, translated, &injected))
+			source = translated;
+		vertexSource = coreVertexShaderCode;
+	}
+
+	if(vertexShader == 0)
+		vertexShader = FFGLShader::CreateVertexShader(vertexSource);
+
+	shader = new FFGLShader;
+	shader->SetVertexShader(vertexShader);
+	shader->BindAttribLocation(POSITION_ATTRIBUTE, "sl_Position");
+	// The first sampler is left at its default of texture unit 0
+	if(!shader->Compile(vertexSource, source.c_str()))
+		printf("Internal shader failed\n");
+
+	for(int i = 0; uniforms && uniforms[i]; i++)
+		locations[i] = shader->FindUniform(uniforms[i]);
+
+	return shader->IsReady() != 0;
+}
+
+void ShaderLoader::DrawToHost(FFGLFBO *target, GLuint hostFbo)
+{
+	if(!CreateInternalShader(copyShader, copyShaderCode))
+		return;
+
+	m_state.BindFramebuffer(hostFbo);
+	glViewport((GLint)m_vpX, (GLint)m_vpY, (GLsizei)m_vpWidth, (GLsizei)m_vpHeight);
+	m_state.UseProgram(copyShader->GetProgram());
+	m_state.BindTexture(GL_TEXTURE0, target->GetTextureHandle());
+	DrawFullscreenTriangle();
+}
+
+// 0 for off, CHECKERBOARD_HALF or CHECKERBOARD_QUARTER
+int ShaderLoader::GetCheckerboardMode()
+{
+	if(m_UserCheckerboard < 0.25f)
+		return 0;
+	return (m_UserCheckerboard < 0.75f) ? CHECKERBOARD_HALF : CHECKERBOARD_QUARTER;
+}
+
+//
+// The pixel of each block rendered this frame. In 2x1 blocks it alternates along
+// each row, which makes a checkerboard, and in 2x2 blocks it goes round the block
+// diagonally first so that every pixel gets a neighbour soon after it is rendered.
+//
+void ShaderLoader::SetCheckerboard(int blockWidth, int blockHeight)
+{
+	static const float offsets[4][2] = { { 0.0f, 0.0f }, { 1.0f, 1.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f } };
+	int n = m_checkerboardFrame++ % (blockWidth*blockHeight);
+
+	m_checkerboard[0] = (float)blockWidth;
+	m_checkerboard[1] = (float)blockHeight;
+	m_checkerboard[2] = (blockHeight == 1) ? (float)n : offsets[n][0];
+	m_checkerboard[3] = (blockHeight == 1) ? 0.0f : offsets[n][1];
+}
+
+// Fill the output from the pixels rendered this frame and the last output
+void ShaderLoader::ResolveCheckerboard(FFGLFBO *current, FFGLFBO *history, FFGLFBO *output)
+{
+	m_state.BindFramebuffer(output->GetFBOHandle());
+	glViewport(0, 0, (GLsizei)output->GetWidth(), (GLsizei)output->GetHeight());
+
+	m_state.UseProgram(resolveShader->GetProgram());
+	resolveShader->SetUniform1i(resolveLocations[RESOLVE_HISTORY], 1);
+	resolveShader->SetUniform4f(resolveLocations[RESOLVE_CHECKERBOARD],
+								m_checkerboard[0], m_checkerboard[1], m_checkerboard[2], m_checkerboard[3]);
+	resolveShader->SetUniform2f(resolveLocations[RESOLVE_CURRENTSIZE],
+								(float)current->GetWidth(), (float)current->GetHeight());
+
+	m_state.BindTexture(GL_TEXTURE0, current->GetTextureHandle());
+	m_state.BindTexture(GL_TEXTURE1, history->GetTextureHandle());
+	DrawFullscreenTriangle();
+}
+
+// Host frames for each rendered frame, from 1 to MAX_RENDER_DIVIDER
+int ShaderLoader::GetRenderDivider()
+{
+	return 1 + (int)(m_UserRenderRate*(float)(MAX_RENDER_DIVIDER - 1) + 0.5f);
+}
+
+//
+// With a render rate divider the last output is drawn to the host again on the
+// frames between those rendered. A frame is rendered straight away if a parameter,
+// an input texture or the viewport has changed since the last one. The time goes
+// on while frames are skipped, so the next frame rendered is at the host time and
+// has the time since the last one rendered for its time delta.
+//
+bool ShaderLoader::DrawCachedFrame(ProcessOpenGLStruct *pGL)
+{
+	bool bChanged = bRedraw;
+	bool bInputs = false;
+
+	for(int i = 0; i < 4; i++) {
+		bInputs = bInputs || IsInputUsed(i);
+		FFGLTextureStruct input = { 0 };
+		if(IsInputUsed(i) && pGL->numInputTextures > (GLuint)i && pGL->inputTextures[i] != NULL)
+			input = *(pGL->inputTextures[i]);
+		if(input.Handle != m_lastInput[i].Handle || input.Width != m_lastInput[i].Width || input.Height != m_lastInput[i].Height)
+			bChanged = true;
+		m_lastInput[i] = input;
+	}
+	bRedraw = false;
+	bStateChanged = bChanged;
+
+	// A shader that reads neither the time nor an input has the same image
+	// until something changes, unless it is still filling in a checkerboard
+	// or has tiles still to render
+	bool bSame = bStatic && !bInputs && !(bCheckerboard && GetCheckerboardMode() > 0) && m_tileNext == 0;
+
+	if(!bChanged && m_output[0] && (bSame || m_skippedFrames < GetRenderDivider() - 1)) {
+		m_skippedFrames++;
+		m_skippedTime += m_timeDelta;
+		DrawToHost(m_output[0], pGL->HostFBO);
+		return true;
+	}
+
+	m_timeDelta += (float)m_skippedTime;
+	m_skippedFrames = 0;
+	m_skippedTime = 0.0;
+
+	return false;
+}
+
+//
+// The image depends only on the parameters, the viewport and the inputs if it
+// reads no time, date or frame count and has no backbuffer or buffers, which
+// have the last frame. The ShaderToy time uniforms are found in the source when it
+// is loaded, and others such as "time" in a GLSL Sandbox file from the uniforms.
+//
+bool ShaderLoader::IsStaticShader()
+{
+	if(!m_shader || m_backbufferLocation >= 0 || bPendingTimeUniform)
+		return false;
+
+	for(int b = 0; b < MAX_BUFFERS; b++) {
+		if(m_buffers[b].shader)
+			return false;
+	}
+
+	for(size_t u = 0; u < m_uniforms.size(); u++) {
+		UniformUpdate update = m_uniforms[u].update;
+		if(update == &ShaderLoader::UpdateTime
+		|| update == &ShaderLoader::UpdateTimeDelta
+		|| update == &ShaderLoader::UpdateFrame
+		|| update == &ShaderLoader::UpdateDate
+		|| update == &ShaderLoader::UpdateChannelTime)
+			return false;
+	}
+
+	return true;
+}
+
+//
+// Draw a fingerprint of each host input the shader samples, a grid of
+// FINGERPRINT_SIZE points across it, and count the points that differ from
+// the last fingerprint with m_fingerprintQuery. A change between the points
+// is missed, which is the price of a fingerprint that costs next to nothing.
+// Returns false if there is no query to render on.
+//
+bool ShaderLoader::FingerprintInputs(ProcessOpenGLStruct *pGL)
+{
+	int width  = FINGERPRINT_SIZE*4; // a square for each channel
+	int height = FINGERPRINT_SIZE;
+	GLenum format = GL_RGBA8;
+	int channels[4];
+	int count = 0;
+
+	for(int i = 0; i < 4; i++) {
+		if(IsInputUsed(i) && pGL->numInputTextures > (GLuint)i && pGL->inputTextures[i] != NULL)
+			channels[count++] = i;
+	}
+	if(count == 0)
+		return false;
+
+	if(!m_fingerprintQuery)
+		glGenQueries(1, &m_fingerprintQuery);
+	if(!m_fingerprintQuery
+	|| !CreateInternalShader(fingerprintShader, fingerprintShaderCode, fingerprintUniforms, fingerprintLocations)
+	|| !PrepareTargets(m_fingerprint, 2, width, height, format))
+		return false;
+
+	m_state.BindFramebuffer(m_fingerprint[1]->GetFBOHandle());
+	m_state.UseProgram(fingerprintShader->GetProgram());
+	m_state.BindTexture(GL_TEXTURE1, m_fingerprint[0]->GetTextureHandle());
+	fingerprintShader->SetUniform1i(fingerprintLocations[FINGERPRINT_HISTORY], 1);
+	fingerprintShader->SetUniform2f(fingerprintLocations[FINGERPRINT_HISTORYSIZE], (float)width, (float)height);
+
+	// The new fingerprint, then the points that differ from the last one
+	// without writing over it
+	for(int pass = 0; pass < 2; pass++) {
+		fingerprintShader->SetUniform1f(fingerprintLocations[FINGERPRINT_COMPARE], (float)pass);
+		if(pass == 1) {
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			glBeginQuery(GL_SAMPLES_PASSED, m_fingerprintQuery);
+		}
+		for(int c = 0; c < count; c++) {
+			const FFGLTextureStruct &input = *(pGL->inputTextures[channels[c]]);
+			glViewport(channels[c]*FINGERPRINT_SIZE, 0, FINGERPRINT_SIZE, FINGERPRINT_SIZE);
+			fingerprintShader->SetUniform2f(fingerprintLocations[FINGERPRINT_SOURCESCALE],
+											(float)input.Width/(float)MAX(1, input.HardwareWidth),
+											(float)input.Height/(float)MAX(1, input.HardwareHeight));
+			m_state.BindTexture(GL_TEXTURE0, input.Handle);
+			DrawFullscreenTriangle();
+		}
+	}
+	glEndQuery(GL_SAMPLES_PASSED);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	std::swap(m_fingerprint[0], m_fingerprint[1]);
+
+	return true;
+}
+
+//
+// Render the next tiles of the image in progress, as many as the scheduler expects
+// to fit in the tile budget. Each tile is a scissored draw of the fullscreen triangle
+// and is flushed on its own, so that no one submission runs long enough to stall
+// the host or have the driver reset the GPU. m_tileNext is back to 0 when the
+// image is complete. Returns the number of tiles drawn.
+//
+int ShaderLoader::DrawTiles(int width, int height)
+{
+	int columns = (width + TILE_SIZE - 1)/TILE_SIZE;
+	int rows    = (height + TILE_SIZE - 1)/TILE_SIZE;
+	int count   = MIN(m_tileScheduler.GetTiles(), columns*rows - m_tileNext);
+
+	glEnable(GL_SCISSOR_TEST);
+	for(int t = 0; t < count; t++) {
+		int x = (m_tileNext % columns)*TILE_SIZE;
+		int y = (m_tileNext / columns)*TILE_SIZE;
+		glScissor(x, y, MIN(TILE_SIZE, width - x), MIN(TILE_SIZE, height - y));
+		DrawFullscreenTriangle();
+		glFlush();
+		m_tileNext++;
+	}
+	glDisable(GL_SCISSOR_TEST);
+
+	if(m_tileNext >= columns*rows)
+		m_tileNext = 0;
+
+	return count;
+}
+
+// Render a buffer to its back target, which then has the last frame
+void ShaderLoader::RenderBuffer(BufferPass &pass, const FFGLTextureStruct *Texture)
+{
+	FFGLFBO *target = pass.target[1];
+
+	m_state.BindFramebuffer(target->GetFBOHandle());
+	glViewport(0, 0, (GLsizei)target->GetWidth(), (GLsizei)target->GetHeight());
+
+	m_activeShader = pass.shader;
+	m_passWidth    = (float)target->GetWidth();
+	m_passHeight   = (float)target->GetHeight();
+	m_state.UseProgram(pass.shader->GetProgram());
+
+	SetPassChannels(pass.channels);
+	UpdatePassUniforms(pass.uniforms, pass.bGlobalsBlock);
+	BindChannels(pass.channels, pass.inputTextureLocation, Texture);
+
+	DrawFullscreenTriangle();
+
+	std::swap(pass.target[0], pass.target[1]);
+}
+
+// The channel resolutions and scales of a pass, from the host
+// inputs or from the last frame of the buffers it samples
+void ShaderLoader::SetPassChannels(const int *channels)
+{
+	for(int i = 0; i < 4; i++) {
+		FFGLFBO *target = (channels[i] == CHANNEL_INPUT ? NULL : m_buffers[channels[i]].target[0]);
+		if(target) {
+			float width  = (float)target->GetWidth();
+			float height = (float)target->GetHeight();
+			m_channelResolution[i][0] = width;
+			m_channelResolution[i][1] = height;
+			m_channelScale[i][0] = 1.0f;
+			m_channelScale[i][1] = 1.0f;
+			m_channelScale[i][2] = 0.5f/width;
+			m_channelScale[i][3] = 0.5f/height;
+		}
+		else {
+			m_channelResolution[i][0] = m_inputResolution[i][0];
+			m_channelResolution[i][1] = m_inputResolution[i][1];
+			for(int j = 0; j < 4; j++)
+				m_channelScale[i][j] = m_inputScale[i][j];
+		}
+		m_channelResolution[i][2] = 1.0f;
+	}
+}
+
+// Bind the host texture, the local copy of it or the last frame of a buffer for each channel a pass uses
+void ShaderLoader::BindChannels(const int *channels, const GLint *inputTextureLocation, const FFGLTextureStruct *Texture)
+{
+	for(int i = 0; i < 4; i++) {
+		if(inputTextureLocation[i] < 0)
+			continue;
+		GLuint texture = 0;
+		if(channels[i] != CHANNEL_INPUT) {
+			if(m_buffers[channels[i]].target[0])
+				texture = m_buffers[channels[i]].target[0]->GetTextureHandle();
+		}
+		else if(Texture[i].Handle > 0)
+			texture = (bChannelDirect[i] ? Texture[i].Handle : m_glTexture[i]);
+		m_state.BindTexture(GL_TEXTURE0 + i, texture);
+	}
+}
+
+void ShaderLoader::UpdatePassUniforms(const std::vector<BoundUniform> &uniforms, bool bGlobals)
+{
+	for(size_t i = 0; i < uniforms.size(); i++)
+		(this->*uniforms[i].update)(uniforms[i].location, uniforms[i].size);
+
+	if(bGlobals)
+		UpdateGlobals();
+}
+
+// One triangle covering the viewport, which is the square -1 to 1 inside it.
+// Unlike a quad there is no diagonal edge where the two triangles meet,
+// so the fragments along it are not shaded twice.
+void ShaderLoader::CreateFullscreenTriangle()
+{
+	static const GLfloat vertices[] = {
+		-1.0f, -1.0f,
+		 3.0f, -1.0f,
+		-1.0f,  3.0f
+	};
+
+	glGenBuffers(1, &fullscreenVbo);
+	glBindBuffer(GL_ARRAY_BUFFER, fullscreenVbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+	glGenVertexArrays(1, &fullscreenVao);
+	glBindVertexArray(fullscreenVao);
+	glVertexAttribPointer(POSITION_ATTRIBUTE, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+	glEnableVertexAttribArray(POSITION_ATTRIBUTE);
+
+	// The vao keeps the buffer, so both go back to the host's defaults
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ShaderLoader::DrawFullscreenTriangle()
+{
+	if(fullscreenVao) {
+		m_state.BindVertexArray(fullscreenVao);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		return;
+	}
+
+	// Legacy drivers without vertex array objects
+	glBegin(GL_TRIANGLES);
+	glVertexAttrib2f(POSITION_ATTRIBUTE, -1.0f, -1.0f);
+	glVertexAttrib2f(POSITION_ATTRIBUTE,  3.0f, -1.0f);
+	glVertexAttrib2f(POSITION_ATTRIBUTE, -1.0f,  3.0f);
+	glEnd();
+}
+
 void ShaderLoader::CreateRectangleTexture(FFGLTextureStruct Texture, FFGLTexCoords maxCoords, GLuint &glTexture, GLenum texunit, GLuint &fbo, GLuint hostFbo)
 {
 	// First create an fbo and a texture the same size if they don't exist
@@ -2066,26 +3415,27 @@ void ShaderLoader::CreateRectangleTexture(FFGLTextureStruct Texture, FFGLTexCoor
 
 	if(glTexture == 0) {
 		glGenTextures(1, &glTexture);
-		m_extensions.glActiveTexture(texunit);
-		glBindTexture(GL_TEXTURE_2D, glTexture);
+		m_state.BindTexture(texunit, glTexture);
 		glTexImage2D(GL_TEXTURE_2D, 0,  GL_RGBA, Texture.Width, Texture.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
 		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		m_extensions.glActiveTexture(GL_TEXTURE0);
 	} // endif created a new texture
 				
-	// Render the incoming texture to the local one via the fbo
-	m_extensions.glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
-	m_extensions.glFramebufferTexture2DEXT(GL_READ_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, glTexture, 0);
-	glBindTexture(GL_TEXTURE_2D, Texture.Handle);
+	// Render the incoming texture to the local one via the fbo.
+	// The fbo keeps its attachment, so it is only attached again when the local texture changes.
+	m_state.BindFramebuffer(fbo);
+	if(m_fboTexture != glTexture) {
+		m_extensions.glFramebufferTexture2DEXT(GL_READ_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, glTexture, 0);
+		m_fboTexture = glTexture;
+	}
+	m_state.BindTexture(GL_TEXTURE0, Texture.Handle);
 				
-	glEnable(GL_TEXTURE_2D);
+	// Fixed function texturing on unit 0 for the copy
+	m_state.UseProgram(0);
+	m_state.EnableTexture2D(true);
 	glBegin(GL_QUADS);
 	//
 	// Must refer to maxCoords here because the texture
@@ -2104,16 +3454,10 @@ void ShaderLoader::CreateRectangleTexture(FFGLTextureStruct Texture, FFGLTexCoor
 	glTexCoord2f((float)maxCoords.s, 0.0);
 	glVertex2f(1.0, -1.0);
 	glEnd();
-	glDisable(GL_TEXTURE_2D);
-
-	// unbind the input texture
-	glBindTexture(GL_TEXTURE_2D, 0);
+	m_state.EnableTexture2D(false);
 
-	// unbind the fbo
-	if(hostFbo)
-		m_extensions.glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, hostFbo);
-	else
-		m_extensions.glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+	// back to the host fbo for the shader draw
+	m_state.BindFramebuffer(hostFbo);
 
 }
 
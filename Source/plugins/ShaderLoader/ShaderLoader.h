@@ -32,9 +32,42 @@
 #define ShaderLoader_H
 
 #include <FFGLShader.h>
+#include <FFGLProgramCache.h>
+#include "ProgramRegistry.h"
+#include "ShaderWatcher.h"
+#include "ShaderParser.h"
+#include "ShaderTranslator.h"
+#include "UniformRing.h"
+#include "TexturePool.h"
+#include "GPUTimer.h"
+#include "ResolutionScaler.h"
+#include "TileScheduler.h"
+#include <FFGLStateCache.h>
+#include <FFGLFBOPool.h>
 #include <FFGLPluginSDK.h>
 #include <FFGLExtensions.h>
 
+#define MAX_SEMANTIC_NAMES 6 // names a uniform semantic can have in a shader
+#define MAX_BUFFERS        4 // ShaderToy Buffer A to D
+#define CHANNEL_INPUT     -1 // an iChannel that samples the host input of the same number
+#define BACKBUFFER_UNIT    4 // texture unit of the GLSL Sandbox backbuffer
+#define CHECKERBOARD_HALF    1 // rendering 2x1 blocks
+#define CHECKERBOARD_QUARTER 2 // rendering 2x2 blocks
+
+// ShaderLoaderGlobals uniform block with std140 layout
+struct ShaderGlobals {
+	float resolution[3];
+	float time;
+	float mouse[4];
+	float date[4];
+	float inputColour[4];
+	float channelTime[4];
+	float channelResolution[4][4]; // vec3 array elements are 16 bytes apart
+	float channelScale[4][4];
+	float timeDelta;
+	int frame;
+	float padding[2]; // the block size is a multiple of 16 bytes
+};
 
 class ShaderLoader : public CFreeFrameGLPlugin
 {
@@ -54,6 +87,8 @@ public:
 	FFResult ProcessOpenGL(ProcessOpenGLStruct* pGL);
 	FFResult InitGL(const FFGLViewportStruct *vp);
 	FFResult DeInitGL();
+	FFResult Resize(const FFGLViewportStruct *vp);
+	FFResult SetTime(double time);
 
 	DWORD GetInputStatus(DWORD dwIndex);
 	float GetFloatParameter(unsigned int dwIndex);
@@ -90,29 +125,41 @@ protected:
 	float m_UserGreen;
 	float m_UserBlue;
 	float m_UserAlpha;
+	float m_UserBudget; // dynamic resolution frame budget, 0 for full resolution
+	float m_UserCheckerboard;
+	float m_UserRenderRate; // host frames for each rendered frame
+	float m_UserTileBudget; // progressive rendering budget, 0 to render the whole image every frame
 
 	bool bInitialized;
 	bool bStarted;
 	bool bDialogOpen;
 	bool bSpoutPanelOpened;
+	bool bShaderPending;
 
 	SHELLEXECUTEINFOA ShExecInfo;
 	HWND hwndEditor;
 
-	// Local fbo and texture
-	GLuint m_glTexture0;
-	GLuint m_glTexture1;
-	GLuint m_glTexture2;
-	GLuint m_glTexture3;
+	// Local fbo and the local copies of the input textures, from the texture pool
+	GLuint m_glTexture[4];
 	GLuint m_fbo;
+	GLuint m_fboTexture; // local texture attached to m_fbo as the copy destination
 
 	// Viewport
+	float m_vpX;
+	float m_vpY;
 	float m_vpWidth;
 	float m_vpHeight;
+	bool bViewportChecked;
+
+	// Size of the pass being drawn, the viewport for the image
+	float m_passWidth;
+	float m_passHeight;
 	
 	// Time
 	double startTime, elapsedTime, lastTime, PCFreq;
 	__int64 CounterStart;
+	double m_hostTime; // Host time in seconds if the host calls SetTime
+	bool bHostTime;
 
 	//
 	// Shader uniforms
@@ -120,6 +167,8 @@ protected:
 
 	// Time
 	float m_time;
+	float m_timeDelta;
+	int m_frame;
 
 	// Date (year, month, day, time in seconds)
 	float m_dateYear;
@@ -134,6 +183,23 @@ protected:
 	// Channel resolution in pixels - 4 channels with width, height, depth each
 	float m_channelResolution[4][3];
 
+	// Input textures sampled without a copy. The texture calls in the shader
+	// are rewritten to scale the coordinates to the image in the texture.
+	// Scale (x, y) and half a texel (x, y) for each channel.
+	float m_channelScale[4][4];
+
+	// The same for the host input textures. The channel values of a pass
+	// are taken from these or from the buffers the pass samples.
+	float m_inputResolution[4][2];
+	float m_inputScale[4][4];
+
+	// What each iChannel of the image samples, CHANNEL_INPUT or a buffer
+	int m_channels[4];
+	int m_pendingChannels[4]; // for m_pendingShader
+	bool bChannelDirect[4];
+	bool bPendingChannelDirect[4]; // for m_pendingShader
+	bool bCopyImage;               // input textures copied with glCopyImageSubData
+
 	// Mouse
 	float m_mouseX;
 	float m_mouseY;
@@ -146,42 +212,191 @@ protected:
 
 	int m_initResources;
 	FFGLExtensions m_extensions;
-    FFGLShader m_shader;
+	FFGLStateCache m_state;      // GL bindings during ProcessOpenGL
+	FFGLShader *m_shader;        // Shared with other instances using the same source
+	FFGLShader *m_pendingShader; // Compiling until it replaces m_shader
+	FFGLShader *m_activeShader;  // The shader of the pass the uniforms are set for
+	ShaderWatcher m_watcher;     // Reloads the shader file when it is saved
+
+	GLint m_inputTextureLocation[4]; // -1 for a channel the shader does not use
+
+	// The image is rendered to a pair of render targets that are swapped every
+	// frame and drawn to the host fbo if it has a GLSL Sandbox backbuffer, which
+	// samples the previous frame in the other target, or is rendered at a scale.
+	GLint m_backbufferLocation;  // -1 if the shader has no backbuffer
+	FFGLFBO *m_output[2];        // m_output[0] has the last frame rendered
+
+	// Dynamic resolution. The scale of the image is chosen from the GPU time
+	// of the frame, measured from the first input copy to the draw to the host.
+	GPUTimer m_timer;
+	ResolutionScaler m_scaler;
+	float m_pendingScaleBounds[2]; // for m_pendingShader
+	float m_pendingHysteresis;
+
+	// Checkerboard rendering. The image is rendered to m_sparse, a half or
+	// a quarter of the output size, which is resolved into the output.
+	bool bCheckerboard;          // the image has gl_FragCoord remapped
+	bool bPendingCheckerboard;   // for m_pendingShader
+	bool bCheckerboardSource;    // the last load asked for the remap
+	bool bPendingVariant;        // m_pendingShader only changes the remap of the image
+	float m_checkerboard[4];     // sl_Checkerboard
+	int m_checkerboardFrame;
+	FFGLFBO *m_sparse;
+
+	// Render rate divider. The frames between those rendered draw m_output[0] again.
+	bool bRedraw;                     // a parameter or the viewport has changed
+	int m_skippedFrames;              // since the last frame rendered
+	double m_skippedTime;             // shader time of the skipped frames
+	FFGLTextureStruct m_lastInput[4]; // the host textures of the last frame
+	bool bStateChanged;               // this frame, from bRedraw and m_lastInput
+
+	// Output memoization. A static shader is rendered over m_output[0] only if
+	// the fingerprint of an input differs from the one in m_fingerprint[0].
+	bool bStatic;                     // the image does not read the time
+	bool bPendingTimeUniform;         // m_pendingShader references a time uniform
+	FFGLFBO *m_fingerprint[2];
+	GLuint m_fingerprintQuery;        // the points that differ, for conditional rendering
 
-	GLint m_inputTextureLocation;
-	GLint m_inputTextureLocation1;
-	GLint m_inputTextureLocation2;
-	GLint m_inputTextureLocation3;
+	// Progressive rendering. The image is rendered into m_output[1] a few tiles
+	// each frame, timed by m_timer, while m_output[0] is drawn to the host.
+	TileScheduler m_tileScheduler;
+	int m_tileNext;                   // the next tile to render, 0 for a new image
+	float m_tileTime;                 // the shader time of the image in progress
+	float m_tileTimeDelta;
+	bool bTiledFrame;                 // the last frame rendered was in tiles
 	
-	GLint m_timeLocation;
-	GLint m_dateLocation;
-	GLint m_channeltimeLocation;
-	GLint m_channelresolutionLocation;
-	GLint m_mouseLocation;
-	GLint m_resolutionLocation;
-	GLint m_mouseLocationVec4;
-	GLint m_screenLocation;
-	GLint m_surfaceSizeLocation;
 	GLint m_surfacePositionLocation;
 	GLint m_vertexPositionLocation;
 
-	// ShaderLoader extras
-	GLint m_inputColourLocation;
+	//
+	// Uniform semantics
+	//
+	// Each semantic is a value the plugin sets, the names a shader can use
+	// for it and the function that sets it every frame. Samplers have no
+	// function and are set once to their texture unit.
+	//
+	typedef void (ShaderLoader::*UniformUpdate)(GLint location, GLint size);
+
+	struct UniformSemantic {
+		const char *names[MAX_SEMANTIC_NAMES];
+		GLenum type;
+		UniformUpdate update;
+		int textureUnit;
+	};
+
+	struct BoundUniform {
+		GLint location;
+		GLint size;
+		UniformUpdate update;
+	};
+
+	static const UniformSemantic m_semantics[];
+	std::vector<BoundUniform> m_uniforms; // updated every frame
+	bool bGlobalsBlock;                   // the shader uses the ShaderLoaderGlobals block
+
+	//
+	// ShaderToy buffers, rendered in order before the image.
+	//
+	// Each renders to a pair of render targets that are swapped every frame,
+	// so a pass that samples its own buffer gets the previous frame. As on
+	// ShaderToy, a pass sampling a later buffer also gets its previous frame
+	// and one sampling an earlier buffer gets the frame just rendered.
+	//
+	struct BufferPass {
+		FFGLShader *shader; // NULL if there is no such buffer
+		std::vector<BoundUniform> uniforms;
+		GLint inputTextureLocation[4];
+		bool bGlobalsBlock;
+		bool bDirect[4];    // host inputs sampled without a copy
+		int channels[4];    // CHANNEL_INPUT or the buffer each iChannel samples
+		float scale;        // of the viewport size
+		GLenum format;
+		FFGLFBO *target[2]; // target[0] has the last frame rendered
+	};
+	BufferPass m_buffers[MAX_BUFFERS];
+	BufferPass m_pendingBuffers[MAX_BUFFERS]; // compiling with m_pendingShader
+
+	// The parts of the fragment source of a program and its key
+	struct ShaderSource {
+		const char *strings[4];
+		GLint lengths[4];
+		int count;
+		std::string header;
+		std::string body;
+		std::string translated;
+		const char *vertexSource;
+		GLuint64 key;
+		bool bCheckerboard; // gl_FragCoord is remapped
+	};
 
 	void SetDefaults();
+	void InitProgramCache();
 	void StartCounter();
 	double GetCounter();
 	HMODULE GetCurrentModule();
 	bool AddModulePath(const char *filename, char *filepath);
 	GLhandleARB compileShader(const char * vtxProgram, const char * fragProgram);
 	bool LoadShaderFile(const char *path);
-	bool LoadShader(std::string shaderString);
+	bool ReadShaderFile(const char *path, std::string &shaderString);
+	void InsertCommon(std::string &shaderString, ShaderParser &parser, const std::string &common);
+	bool LoadShader(const std::string &shaderString, const ShaderParser &parser,
+					const std::string *bufferStrings, const ShaderParser *bufferParsers);
+	void GetChannels(const ShaderParser &parser, const bool *bBuffers, int *channels);
+	void BuildSource(const std::string &shaderString, const ShaderParser &parser, const int *channels,
+					 bool bCheckerboard, bool *bDirect, ShaderSource &source);
+	FFGLShader *AcquireProgram(const ShaderSource &source);
+	void ResetBufferPass(BufferPass &pass);
+	void ReleasePendingShaders();
+	bool CheckPendingShader();
+	void BindUniforms(FFGLShader *shader, std::vector<BoundUniform> &uniforms, GLint *inputTextureLocation,
+					  GLint *backbufferLocation, bool &bGlobals);
+	bool IsInputUsed(int channel);
+	bool PrepareTargets(FFGLFBO **targets, int count, int width, int height, GLenum &format);
+	void ReleaseTargets(FFGLFBO **targets, int count);
+	void PrepareBufferTargets(BufferPass &pass);
+	bool CreateInternalShader(FFGLShader *&shader, const char *code, const char **uniforms = NULL, GLint *locations = NULL);
+	void DrawToHost(FFGLFBO *target, GLuint hostFbo);
+	int GetCheckerboardMode();
+	void SetCheckerboard(int blockWidth, int blockHeight);
+	void ResolveCheckerboard(FFGLFBO *current, FFGLFBO *history, FFGLFBO *output);
+	int GetRenderDivider();
+	bool DrawCachedFrame(ProcessOpenGLStruct *pGL);
+	bool IsStaticShader();
+	bool FingerprintInputs(ProcessOpenGLStruct *pGL);
+	int DrawTiles(int width, int height);
+	void RenderBuffer(BufferPass &pass, const FFGLTextureStruct *Texture);
+	void SetPassChannels(const int *channels);
+	void BindChannels(const int *channels, const GLint *inputTextureLocation, const FFGLTextureStruct *Texture);
+	void UpdatePassUniforms(const std::vector<BoundUniform> &uniforms, bool bGlobals);
+	static const UniformSemantic *FindSemantic(const char *name);
+	void UpdateTime(GLint location, GLint size);
+	void UpdateTimeDelta(GLint location, GLint size);
+	void UpdateFrame(GLint location, GLint size);
+	void UpdateDate(GLint location, GLint size);
+	void UpdateChannelTime(GLint location, GLint size);
+	void UpdateScreen(GLint location, GLint size);
+	void UpdateResolution(GLint location, GLint size);
+	void UpdateChannelResolution(GLint location, GLint size);
+	void UpdateChannelScale(GLint location, GLint size);
+	void UpdateCheckerboard(GLint location, GLint size);
+	void UpdateMouse(GLint location, GLint size);
+	void UpdateSurfaceSize(GLint location, GLint size);
+	void UpdateMouseVec4(GLint location, GLint size);
+	void UpdateInputColour(GLint location, GLint size);
+	void UpdateGlobals();
+	void PrintUniformCounts();
+	void CalculateDate();
 	bool WritePathToRegistry(const char *filepath, const char *subkey, const char *valuename);
 	bool ReadPathFromRegistry(const char *filepath, const char *subkey, const char *valuename);
 	bool SelectSpoutPanel(const char *message);
 	bool OpenEditor(const char *filename);
 	bool CheckSpoutPanel();
+	void PrepareInputTexture(const FFGLTextureStruct &Texture, int channel, GLuint hostFbo);
+	void ReleaseInputTexture(int channel);
+	void CopyInputTexture(const FFGLTextureStruct &Texture, GLuint &glTexture, GLuint hostFbo);
 	void CreateRectangleTexture(FFGLTextureStruct Texture, FFGLTexCoords maxCoords, GLuint &glTexture, GLenum texunit, GLuint &fbo, GLuint hostFbo);
+	void CreateFullscreenTriangle();
+	void DrawFullscreenTriangle();
 
 };
 
@@ -0,0 +1,314 @@
+//
+//		ShaderParser.cpp
+//
+//		Reads a shader file in one pass to find what the loader needs to know
+//		about it : the dialect, the #version line, the entry point and the
+//		uniforms it declares and the names it uses.
+//
+//		The source is split into tokens with comments and whitespace skipped,
+//		so declarations are found however they are laid out. Every identifier
+//		is recorded, which is enough to tell whether a uniform is used without
+//		a full GLSL parser.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ShaderParser.h"
+
+ShaderParser::ShaderParser()
+{
+	m_version    = 0;
+	m_bodyStart  = 0;
+	m_bMain      = false;
+	m_bMainImage = false;
+}
+
+bool ShaderParser::Parse(const std::string &source)
+{
+	const char *start = source.c_str();
+	const char *p = start;
+	bool bLineStart = true;
+	bool bDirective = false;
+	int braceDepth = 0;
+
+	// Declaration state : "uniform" [precision] type name [ "[" size "]" ] { "," name } ";"
+	int uniformState = 0; // 0 none, 1 after uniform, 2 after the type, 3 after a name
+	std::string uniformType;
+
+	// The last two identifiers at file scope for "void main ("
+	std::string previous, last;
+
+	// Sampler call state : name "(" sampler ","
+	int callState = 0; // 0 none, 1 after the name, 2 after "(", 3 after the sampler
+	SamplerCall call;
+
+	m_version    = 0;
+	m_bodyStart  = 0;
+	m_bMain      = false;
+	m_bMainImage = false;
+	m_uniforms.clear();
+	m_samplerCalls.clear();
+	m_fragCoords.clear();
+	m_identifiers.clear();
+	m_pragmas.clear();
+
+	while(*p) {
+
+		// Comments
+		if(p[0] == '/' && p[1] == '/') {
+			while(*p && *p != '\n') p++;
+			continue;
+		}
+		if(p[0] == '/' && p[1] == '*') {
+			p += 2;
+			while(*p && !(p[0] == '*' && p[1] == '/')) p++;
+			if(*p) p += 2;
+			continue;
+		}
+
+		// Line continuation
+		if(p[0] == '\\' && (p[1] == '\n' || (p[1] == '\r' && p[2] == '\n'))) {
+			p += (p[1] == '\r') ? 3 : 2;
+			continue;
+		}
+
+		if(*p == '\n') {
+			bDirective = false;
+			bLineStart = true;
+			p++;
+			continue;
+		}
+
+		if(isspace((unsigned char)*p)) {
+			p++;
+			continue;
+		}
+
+		// Preprocessor line
+		if(bLineStart && *p == '#') {
+			bLineStart = false;
+			bDirective = true;
+			callState = 0;
+			p++;
+			while(*p == ' ' || *p == '\t') p++;
+			if(strncmp(p, "version", 7) == 0 && !isalnum((unsigned char)p[7]) && p[7] != '_') {
+				m_version = atoi(p + 7);
+				// Anything inserted goes after this line
+				while(*p && *p != '\n') p++;
+				if(*p) p++;
+				m_bodyStart = (size_t)(p - start);
+				bDirective = false;
+				bLineStart = true;
+			}
+			else if(strncmp(p, "pragma", 6) == 0 && (p[6] == ' ' || p[6] == '\t')) {
+				// "#pragma name value" with the value up to the end of the line.
+				// The names in it are not references.
+				const char *name = p + 6;
+				while(*name == ' ' || *name == '\t') name++;
+				const char *value = name;
+				while(*value && !isspace((unsigned char)*value)) value++;
+				std::string pragma(name, value - name);
+				while(*value == ' ' || *value == '\t') value++;
+				const char *end = value;
+				while(*end && *end != '\n') end++;
+				while(end > value && isspace((unsigned char)end[-1])) end--;
+				if(!pragma.empty())
+					m_pragmas[pragma].assign(value, end - value);
+				while(*p && *p != '\n') p++;
+			}
+			continue;
+		}
+		bLineStart = false;
+
+		// Identifier
+		if(isalpha((unsigned char)*p) || *p == '_') {
+			const char *word = p;
+			while(isalnum((unsigned char)*p) || *p == '_') p++;
+			std::string identifier(word, p - word);
+			m_identifiers[identifier]++;
+
+			if(bDirective)
+				continue;
+
+			if(identifier == "gl_FragCoord")
+				m_fragCoords.push_back((size_t)(word - start));
+
+			if(callState == 2) {
+				call.sampler = identifier;
+				callState = 3;
+			}
+			else if(identifier == "texture2D" || identifier == "texture") {
+				call.offset = (size_t)(word - start);
+				callState = 1;
+			}
+			else {
+				callState = 0;
+			}
+
+			if(braceDepth == 0) {
+				if(uniformState == 0 && identifier == "uniform") {
+					uniformState = 1;
+				}
+				else if(uniformState == 1) {
+					if(identifier != "lowp" && identifier != "mediump" && identifier != "highp") {
+						uniformType = identifier;
+						uniformState = 2;
+					}
+				}
+				else if(uniformState == 2) {
+					Uniform uniform;
+					uniform.type = uniformType;
+					uniform.name = identifier;
+					uniform.arraySize = 0;
+					m_uniforms.push_back(uniform);
+					uniformState = 3;
+				}
+				previous = last;
+				last = identifier;
+			}
+			continue;
+		}
+
+		// Number, which can start with a "."
+		if(isdigit((unsigned char)*p) || (*p == '.' && isdigit((unsigned char)p[1]))) {
+			const char *number = p;
+			callState = 0;
+			while(isalnum((unsigned char)*p) || *p == '.' || ((*p == '+' || *p == '-') && (p[-1] == 'e' || p[-1] == 'E'))) p++;
+			if(uniformState == 3 && !bDirective && !m_uniforms.empty())
+				m_uniforms.back().arraySize = atoi(number);
+			continue;
+		}
+
+		// Punctuation
+		if(!bDirective) {
+			switch(*p) {
+				case '{':
+					braceDepth++;
+					break;
+				case '}':
+					if(braceDepth > 0) braceDepth--;
+					break;
+				case '(':
+					if(braceDepth == 0 && uniformState == 0 && previous == "void") {
+						if(last == "main") m_bMain = true;
+						if(last == "mainImage") m_bMainImage = true;
+					}
+					break;
+				case ',':
+					if(uniformState == 3) uniformState = 2;
+					if(callState == 3) {
+						call.end = (size_t)(p + 1 - start);
+						m_samplerCalls.push_back(call);
+					}
+					break;
+				case ';':
+					uniformState = 0;
+					break;
+				default:
+					break;
+			}
+			callState = (*p == '(' && callState == 1) ? 2 : 0;
+			if(braceDepth == 0) {
+				previous.clear();
+				last.clear();
+			}
+		}
+		p++;
+	}
+
+	return (m_bMain || m_bMainImage);
+}
+
+ShaderParser::Dialect ShaderParser::GetDialect() const
+{
+	return IsDeclared("time") ? DIALECT_GLSLSANDBOX : DIALECT_SHADERTOY;
+}
+
+int ShaderParser::GetVersion() const
+{
+	return m_version;
+}
+
+size_t ShaderParser::GetBodyStart() const
+{
+	return m_bodyStart;
+}
+
+bool ShaderParser::HasMain() const
+{
+	return m_bMain;
+}
+
+bool ShaderParser::HasMainImage() const
+{
+	return m_bMainImage;
+}
+
+bool ShaderParser::IsDeclared(const char *name) const
+{
+	for(size_t i = 0; i < m_uniforms.size(); i++) {
+		if(m_uniforms[i].name == name)
+			return true;
+	}
+	return false;
+}
+
+bool ShaderParser::IsReferenced(const char *name) const
+{
+	return (m_identifiers.find(name) != m_identifiers.end());
+}
+
+int ShaderParser::GetReferenceCount(const char *name) const
+{
+	std::map<std::string, int>::const_iterator it = m_identifiers.find(name);
+	return (it != m_identifiers.end()) ? it->second : 0;
+}
+
+const std::vector<ShaderParser::Uniform> &ShaderParser::GetUniforms() const
+{
+	return m_uniforms;
+}
+
+const std::vector<ShaderParser::SamplerCall> &ShaderParser::GetSamplerCalls() const
+{
+	return m_samplerCalls;
+}
+
+const std::vector<size_t> &ShaderParser::GetFragCoords() const
+{
+	return m_fragCoords;
+}
+
+bool ShaderParser::GetPragma(const char *name, std::string &value) const
+{
+	std::map<std::string, std::string>::const_iterator it = m_pragmas.find(name);
+	if(it == m_pragmas.end())
+		return false;
+	value = it->second;
+	return true;
+}
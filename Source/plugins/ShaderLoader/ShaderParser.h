@@ -0,0 +1,107 @@
+//
+//		ShaderParser.h
+//
+//		Reads a shader file in one pass to find what the loader needs to know
+//		about it : the dialect, the #version line, the entry point and the
+//		uniforms it declares and the names it uses.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#pragma once
+#ifndef ShaderParser_H
+#define ShaderParser_H
+
+#include <string>
+#include <vector>
+#include <map>
+
+class ShaderParser
+{
+
+public:
+
+	enum Dialect {
+		DIALECT_GLSLSANDBOX, // declares "uniform float time"
+		DIALECT_SHADERTOY    // uniforms are supplied by the loader
+	};
+
+	struct Uniform {
+		std::string type;
+		std::string name;
+		int arraySize; // 0 if not an array
+	};
+
+	// A call of texture2D or texture with a sampler name as its first argument
+	struct SamplerCall {
+		size_t offset; // of the function name
+		size_t end;    // of the source following the comma after the sampler
+		std::string sampler;
+	};
+
+	ShaderParser();
+
+	// Returns false if there is no main or mainImage function
+	bool Parse(const std::string &source);
+
+	Dialect GetDialect() const;
+
+	// Number in the #version line or 0 if there is none
+	int GetVersion() const;
+
+	// Offset of the source following the #version line, where
+	// declarations can be inserted
+	size_t GetBodyStart() const;
+
+	bool HasMain() const;
+	bool HasMainImage() const;
+
+	bool IsDeclared(const char *name) const;
+	bool IsReferenced(const char *name) const;
+	int GetReferenceCount(const char *name) const; // including a declaration
+	const std::vector<Uniform> &GetUniforms() const;
+	const std::vector<SamplerCall> &GetSamplerCalls() const;
+
+	// Offsets of the uses of gl_FragCoord outside preprocessor lines
+	const std::vector<size_t> &GetFragCoords() const;
+
+	// The rest of a "#pragma name value" line, for options given in the
+	// shader file. Returns false if there is no such line.
+	bool GetPragma(const char *name, std::string &value) const;
+
+protected:
+
+	int m_version;
+	size_t m_bodyStart;
+	bool m_bMain;
+	bool m_bMainImage;
+	std::vector<Uniform> m_uniforms;
+	std::vector<SamplerCall> m_samplerCalls;
+	std::vector<size_t> m_fragCoords;
+	std::map<std::string, int> m_identifiers; // with the number of times each is used
+	std::map<std::string, std::string> m_pragmas;
+
+};
+
+#endif
@@ -0,0 +1,312 @@
+//
+//		ShaderTranslator.cpp
+//
+//		Rewrites a legacy fragment shader as GLSL 3.30 core.
+//
+//		The source is copied token by token with comments and layout kept, so
+//		compile errors still point at the lines of the file. Identifiers are
+//		looked up in a table of replacements :
+//
+//			gl_FragColor, gl_FragData	declared outputs
+//			gl_TexCoord, gl_Color		the outputs of the core vertex shader
+//			varying						in
+//			texture2D and the like		texture, textureLod and textureProj
+//
+//		Names that a legacy shader is free to use but that are built in or
+//		reserved in GLSL 3.30, such as a function called "round" or a
+//		sampler called "texture", get an "sl_" prefix. Text added by the
+//		plugin, such as a "layout(std140)" uniform block, keeps them.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ShaderTranslator.h"
+
+ShaderTranslator::ShaderTranslator()
+{
+	m_version = 0;
+}
+
+bool ShaderTranslator::Translate(const std::string &source, std::string &result, const Ranges *injected)
+{
+	const char *start = source.c_str();
+	const char *p = start;
+	bool bLineStart = true;
+	bool bDirective = false;
+	bool bDirectiveName = false;
+	int conditionalDepth = 0;
+
+	// The declarations go before the first statement, on a line outside any
+	// #if so that they are compiled whatever the preprocessor selects
+	size_t lineStart = 0;
+	size_t insertAt = std::string::npos;
+	bool bFragColor = false;
+	bool bFragData = false;
+	bool bTexCoord = false;
+	bool bColor = false;
+
+	result.clear();
+
+	// The version decides which names are free to the shader
+	m_version = 0;
+	while(*p) {
+		while(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+		if(*p == '#') {
+			p++;
+			while(*p == ' ' || *p == '\t') p++;
+			if(strncmp(p, "version", 7) == 0) {
+				m_version = atoi(p + 7);
+				break;
+			}
+		}
+		while(*p && *p != '\n') p++;
+	}
+	if(m_version >= 330)
+		return false;
+
+	AddNames(m_version);
+
+	result.reserve(source.size() + 256);
+	if(m_version == 0) {
+		result = "#version 330 core\n";
+		lineStart = result.size();
+	}
+
+	p = start;
+	while(*p) {
+
+		// Comments
+		if(p[0] == '/' && p[1] == '/') {
+			const char *comment = p;
+			while(*p && *p != '\n') p++;
+			result.append(comment, p - comment);
+			continue;
+		}
+		if(p[0] == '/' && p[1] == '*') {
+			const char *comment = p;
+			p += 2;
+			while(*p && !(p[0] == '*' && p[1] == '/')) p++;
+			if(*p) p += 2;
+			result.append(comment, p - comment);
+			continue;
+		}
+
+		// Line continuation
+		if(p[0] == '\\' && (p[1] == '\n' || (p[1] == '\r' && p[2] == '\n'))) {
+			int length = (p[1] == '\r') ? 3 : 2;
+			result.append(p, length);
+			p += length;
+			continue;
+		}
+
+		if(*p == '\n') {
+			bDirective = false;
+			bLineStart = true;
+			result += *p++;
+			if(conditionalDepth == 0)
+				lineStart = result.size();
+			continue;
+		}
+
+		if(isspace((unsigned char)*p)) {
+			result += *p++;
+			continue;
+		}
+
+		// Preprocessor line
+		if(bLineStart && *p == '#') {
+			const char *directive = p;
+			bLineStart = false;
+			p++;
+			while(*p == ' ' || *p == '\t') p++;
+			if(strncmp(p, "version", 7) == 0 && !isalnum((unsigned char)p[7]) && p[7] != '_') {
+				// Replaced in place so that the lines do not move
+				while(*p && *p != '\n') p++;
+				result += "#version 330 core";
+				continue;
+			}
+			result.append(directive, p - directive);
+			bDirective = true;
+			bDirectiveName = true;
+			continue;
+		}
+		bLineStart = false;
+
+		// Identifier
+		if(isalpha((unsigned char)*p) || *p == '_') {
+			const char *word = p;
+			while(isalnum((unsigned char)*p) || *p == '_') p++;
+			std::string identifier(word, p - word);
+
+			if(bDirectiveName) {
+				if(identifier == "if" || identifier == "ifdef" || identifier == "ifndef")
+					conditionalDepth++;
+				else if(identifier == "endif" && conditionalDepth > 0)
+					conditionalDepth--;
+				bDirectiveName = false;
+			}
+			else if(!bDirective && insertAt == std::string::npos) {
+				insertAt = lineStart;
+			}
+
+			std::map<std::string, std::string>::const_iterator it = m_names.find(identifier);
+			if(it == m_names.end() || (m_reserved.count(identifier) && IsInjected(injected, word - start))) {
+				result += identifier;
+				continue;
+			}
+
+			if(identifier == "gl_FragColor") bFragColor = true;
+			if(identifier == "gl_FragData") bFragData = true;
+			if(identifier == "gl_TexCoord") bTexCoord = true;
+			if(identifier == "gl_Color") bColor = true;
+			result += it->second;
+			continue;
+		}
+
+		// Number, which can start with a "."
+		if(isdigit((unsigned char)*p) || (*p == '.' && isdigit((unsigned char)p[1]))) {
+			const char *number = p;
+			while(isalnum((unsigned char)*p) || *p == '.' || ((*p == '+' || *p == '-') && (p[-1] == 'e' || p[-1] == 'E'))) p++;
+			result.append(number, p - number);
+			continue;
+		}
+
+		// Punctuation
+		if(!bDirective && insertAt == std::string::npos)
+			insertAt = lineStart;
+		result += *p++;
+	}
+
+	std::string declarations;
+	if(bFragColor) declarations += "out vec4 sl_FragColor;\n";
+	if(bFragData)  declarations += "out vec4 sl_FragData[1];\n";
+	if(bTexCoord)  declarations += "in vec4 sl_TexCoord[1];\n";
+	if(bColor)     declarations += "const vec4 sl_Color = vec4(1.0);\n";
+
+	if(insertAt == std::string::npos)
+		insertAt = result.size();
+	result.insert(insertAt, declarations);
+
+	return true;
+}
+
+bool ShaderTranslator::IsInjected(const Ranges *injected, size_t offset)
+{
+	for(size_t i = 0; injected && i < injected->size(); i++) {
+		if(offset >= (*injected)[i].first && offset < (*injected)[i].second)
+			return true;
+	}
+	return false;
+}
+
+int ShaderTranslator::GetSourceVersion() const
+{
+	return m_version;
+}
+
+void ShaderTranslator::AddNames(int version)
+{
+	// Legacy built in names and their GLSL 3.30 replacements
+	static const struct {
+		const char *legacy;
+		const char *core;
+	} replacements[] = {
+		{ "gl_FragColor",     "sl_FragColor" },
+		{ "gl_FragData",      "sl_FragData" },
+		{ "gl_TexCoord",      "sl_TexCoord" },
+		{ "gl_Color",         "sl_Color" },
+		{ "varying",          "in" },
+		{ "texture1D",        "texture" },
+		{ "texture2D",        "texture" },
+		{ "texture3D",        "texture" },
+		{ "textureCube",      "texture" },
+		{ "texture2DLod",     "textureLod" },
+		{ "textureCubeLod",   "textureLod" },
+		{ "texture2DProj",    "textureProj" },
+		{ "texture2DProjLod", "textureProjLod" },
+	};
+
+	// Names built in or reserved from a version, which a shader
+	// of an earlier version can have declared itself
+	static const struct {
+		const char *name;
+		int version;
+	} reserved[] = {
+		{ "centroid",       120 },
+		{ "invariant",      120 },
+		{ "transpose",      120 },
+		{ "outerProduct",   120 },
+		{ "flat",           130 },
+		{ "smooth",         130 },
+		{ "noperspective",  130 },
+		{ "case",           130 },
+		{ "uint",           130 },
+		{ "uvec2",          130 },
+		{ "uvec3",          130 },
+		{ "uvec4",          130 },
+		{ "texture",        130 },
+		{ "textureLod",     130 },
+		{ "textureProj",    130 },
+		{ "textureProjLod", 130 },
+		{ "textureOffset",  130 },
+		{ "textureSize",    130 },
+		{ "textureGrad",    130 },
+		{ "texelFetch",     130 },
+		{ "round",          130 },
+		{ "roundEven",      130 },
+		{ "trunc",          130 },
+		{ "sinh",           130 },
+		{ "cosh",           130 },
+		{ "tanh",           130 },
+		{ "asinh",          130 },
+		{ "acosh",          130 },
+		{ "atanh",          130 },
+		{ "isnan",          130 },
+		{ "isinf",          130 },
+		{ "layout",         140 },
+		{ "inverse",        140 },
+		{ "determinant",    150 },
+	};
+
+	// No #version is GLSL 1.10
+	if(version == 0)
+		version = 110;
+
+	m_names.clear();
+	m_reserved.clear();
+
+	for(int i = 0; i < sizeof(reserved)/sizeof(reserved[0]); i++) {
+		if(version < reserved[i].version) {
+			m_names[reserved[i].name] = std::string("sl_") + reserved[i].name;
+			m_reserved.insert(reserved[i].name);
+		}
+	}
+
+	for(int i = 0; i < sizeof(replacements)/sizeof(replacements[0]); i++)
+		m_names[replacements[i].legacy] = replacements[i].core;
+}
@@ -0,0 +1,70 @@
+//
+//		ShaderTranslator.h
+//
+//		Rewrites a legacy fragment shader as GLSL 3.30 core so that it can be
+//		compiled on a core profile context. Outputs, texture functions and
+//		names that became reserved are renamed, without a full GLSL parser.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#pragma once
+#ifndef ShaderTranslator_H
+#define ShaderTranslator_H
+
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+
+class ShaderTranslator
+{
+
+public:
+
+	ShaderTranslator();
+
+	// Start and end offsets of text in the source
+	typedef std::vector< std::pair<size_t, size_t> > Ranges;
+
+	// Returns false if the source is already GLSL 3.30 or later,
+	// which is then used as it is. Names reserved in GLSL 3.30 are
+	// not renamed in the injected ranges, the text the plugin adds.
+	bool Translate(const std::string &source, std::string &result, const Ranges *injected = NULL);
+
+	// Number in the #version line of the last source or 0 if there is none
+	int GetSourceVersion() const;
+
+protected:
+
+	int m_version;
+	std::map<std::string, std::string> m_names; // legacy names and their replacements
+	std::set<std::string> m_reserved;           // those of them only renamed in the shader's own text
+
+	void AddNames(int version);
+	static bool IsInjected(const Ranges *injected, size_t offset);
+
+};
+
+#endif
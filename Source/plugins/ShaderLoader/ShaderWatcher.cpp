@@ -0,0 +1,322 @@
+//
+//		ShaderWatcher.cpp
+//
+//		Watches the loaded shader file and reports when it has been saved
+//		with a change that needs a recompile.
+//
+//		A thread waits on ReadDirectoryChangesW for the folder of the file,
+//		so there is no file system work on the render thread. Editors often
+//		write a file several times for one save, so the file is only read
+//		once there have been no changes to it for WATCH_DEBOUNCE msec. The
+//		source is then hashed without comments and formatting, and a change
+//		is only reported if the hash differs from the source last loaded.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#include <stdio.h>
+#include <ctype.h>
+#include <Shlwapi.h> // for PathRemoveFileSpec
+
+#include "ShaderWatcher.h"
+
+#define WATCH_DEBOUNCE (150) // msec
+
+ShaderWatcher::ShaderWatcher()
+{
+	m_hThread      = NULL;
+	m_hStop        = CreateEventA(NULL, TRUE, FALSE, NULL);
+	m_folder[0]    = 0;
+	m_filename[0]  = 0;
+	m_wfilename[0] = 0;
+	m_hash         = 0;
+	m_changed      = 0;
+	InitializeCriticalSection(&m_cs);
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+	Stop();
+	if(m_hStop) CloseHandle(m_hStop);
+	DeleteCriticalSection(&m_cs);
+}
+
+bool ShaderWatcher::Watch(const char *path, const std::string &source)
+{
+	char folder[MAX_PATH];
+	char filename[MAX_PATH];
+
+	strcpy_s(folder, MAX_PATH, path);
+	PathRemoveFileSpecA(folder);
+	if(!folder[0])
+		strcpy_s(folder, MAX_PATH, ".");
+	strcpy_s(filename, MAX_PATH, path);
+	PathStripPathA(filename);
+
+	// The content the next save is compared with
+	EnterCriticalSection(&m_cs);
+	m_hash = HashTokens(source.c_str());
+	LeaveCriticalSection(&m_cs);
+	InterlockedExchange(&m_changed, 0);
+
+	// Already watching it
+	if(m_hThread && _stricmp(folder, m_folder) == 0 && _stricmp(filename, m_filename) == 0)
+		return true;
+
+	Stop();
+
+	strcpy_s(m_folder, MAX_PATH, folder);
+	strcpy_s(m_filename, MAX_PATH, filename);
+	MultiByteToWideChar(CP_ACP, 0, m_filename, -1, m_wfilename, MAX_PATH);
+
+	ResetEvent(m_hStop);
+	m_hThread = CreateThread(NULL, 0, WatchThread, (LPVOID)this, 0, NULL);
+
+	return (m_hThread != NULL);
+}
+
+void ShaderWatcher::Stop()
+{
+	if(m_hThread) {
+		SetEvent(m_hStop);
+		WaitForSingleObject(m_hThread, INFINITE);
+		CloseHandle(m_hThread);
+		m_hThread = NULL;
+	}
+}
+
+bool ShaderWatcher::HasChanged()
+{
+	return (InterlockedExchange(&m_changed, 0) != 0);
+}
+
+DWORD WINAPI ShaderWatcher::WatchThread(LPVOID param)
+{
+	((ShaderWatcher *)param)->Run();
+	return 0;
+}
+
+void ShaderWatcher::Run()
+{
+	OVERLAPPED overlapped;
+	DWORD buffer[4096]; // DWORD aligned for ReadDirectoryChangesW
+	DWORD dwBytes = 0;
+	DWORD dwDue = 0;
+	bool bReading = false;
+	bool bPending = false;
+
+	HANDLE hDir = CreateFileA(m_folder, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+							  NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+	if(hDir == INVALID_HANDLE_VALUE) {
+		printf("ShaderWatcher - cannot watch [%s]\n", m_folder);
+		return;
+	}
+
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	HANDLE handles[2] = { m_hStop, overlapped.hEvent };
+
+	while(true) {
+
+		if(!bReading) {
+			ResetEvent(overlapped.hEvent);
+			if(!ReadDirectoryChangesW(hDir, buffer, sizeof(buffer), FALSE,
+									  FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+									  NULL, &overlapped, NULL))
+				break;
+			bReading = true;
+		}
+
+		// Wait for a change, or for the end of a burst of changes
+		DWORD dwTimeout = INFINITE;
+		if(bPending) {
+			DWORD dwNow = GetTickCount();
+			dwTimeout = ((int)(dwDue - dwNow) > 0) ? dwDue - dwNow : 0;
+		}
+
+		DWORD dwWait = WaitForMultipleObjects(2, handles, FALSE, dwTimeout);
+
+		if(dwWait == WAIT_OBJECT_0 + 1) {
+			bReading = false;
+			dwBytes = 0;
+			GetOverlappedResult(hDir, &overlapped, &dwBytes, FALSE);
+			// No records means the buffer overflowed, so check the file anyway.
+			// Every change in a burst starts the wait again.
+			if(dwBytes == 0 || IsWatchedFile((const FILE_NOTIFY_INFORMATION *)buffer)) {
+				bPending = true;
+				dwDue = GetTickCount() + WATCH_DEBOUNCE;
+			}
+		}
+		else if(dwWait == WAIT_TIMEOUT && bPending) {
+			// Try again later if the editor still has the file open
+			bPending = !CheckFile();
+			dwDue = GetTickCount() + WATCH_DEBOUNCE;
+		}
+		else {
+			break; // stopped
+		}
+	}
+
+	// The read has to finish before the buffer goes
+	if(bReading) {
+		CancelIo(hDir);
+		GetOverlappedResult(hDir, &overlapped, &dwBytes, TRUE);
+	}
+
+	CloseHandle(overlapped.hEvent);
+	CloseHandle(hDir);
+}
+
+bool ShaderWatcher::IsWatchedFile(const FILE_NOTIFY_INFORMATION *info)
+{
+	size_t length = wcslen(m_wfilename);
+
+	while(true) {
+		// Editors that save to a temporary file rename it to this name
+		if(info->FileNameLength/sizeof(WCHAR) == length && _wcsnicmp(info->FileName, m_wfilename, length) == 0)
+			return true;
+		if(info->NextEntryOffset == 0)
+			return false;
+		info = (const FILE_NOTIFY_INFORMATION *)((const char *)info + info->NextEntryOffset);
+	}
+}
+
+// Returns false if the file could not be read
+bool ShaderWatcher::CheckFile()
+{
+	char path[MAX_PATH];
+	std::string source;
+	char buffer[4096];
+	FILE *file = NULL;
+	size_t count;
+
+	strcpy_s(path, MAX_PATH, m_folder);
+	strcat_s(path, MAX_PATH, "\\");
+	strcat_s(path, MAX_PATH, m_filename);
+
+	if(fopen_s(&file, path, "rb") != 0 || file == NULL)
+		return false;
+	while((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		source.append(buffer, count);
+	fclose(file);
+
+	unsigned __int64 hash = HashTokens(source.c_str());
+
+	EnterCriticalSection(&m_cs);
+	if(hash != m_hash) {
+		m_hash = hash;
+		InterlockedExchange(&m_changed, 1);
+	}
+	LeaveCriticalSection(&m_cs);
+
+	return true;
+}
+
+// Characters that join up into one token if the whitespace between them is removed
+static int TokenClass(char c)
+{
+	if(isalnum((unsigned char)c) || c == '_' || c == '.')
+		return 1;
+	if(strchr("+-*/%<>=!&|^", c) != NULL)
+		return 2;
+	return 0;
+}
+
+//
+// 64 bit FNV-1a of the source tokens. Comments and whitespace are left out
+// except where whitespace separates two tokens that would otherwise join up,
+// and the end of a preprocessor line.
+//
+unsigned __int64 ShaderWatcher::HashTokens(const char *source)
+{
+	unsigned __int64 hash = 14695981039346656037ULL;
+	const char *p = source;
+	char last = 0;
+	bool bSpace = false;
+	bool bLineStart = true;
+	bool bDirective = false;
+
+	while(*p) {
+
+		// Comments
+		if(p[0] == '/' && p[1] == '/') {
+			while(*p && *p != '\n') p++;
+			continue;
+		}
+		if(p[0] == '/' && p[1] == '*') {
+			p += 2;
+			while(*p && !(p[0] == '*' && p[1] == '/')) p++;
+			if(*p) p += 2;
+			bSpace = true;
+			continue;
+		}
+
+		// Line continuation
+		if(p[0] == '\\' && (p[1] == '\n' || (p[1] == '\r' && p[2] == '\n'))) {
+			p += (p[1] == '\r') ? 3 : 2;
+			bSpace = true;
+			continue;
+		}
+
+		// A preprocessor line ends at the end of the line
+		if(*p == '\n') {
+			if(bDirective) {
+				hash ^= (unsigned char)'\n';
+				hash *= 1099511628211ULL;
+				last = '\n';
+				bDirective = false;
+				bSpace = false;
+			}
+			else {
+				bSpace = true;
+			}
+			bLineStart = true;
+			p++;
+			continue;
+		}
+
+		if(isspace((unsigned char)*p)) {
+			bSpace = true;
+			p++;
+			continue;
+		}
+
+		if(bLineStart && *p == '#')
+			bDirective = true;
+		bLineStart = false;
+
+		if(bSpace && TokenClass(last) != 0 && TokenClass(last) == TokenClass(*p)) {
+			hash ^= (unsigned char)' ';
+			hash *= 1099511628211ULL;
+		}
+		bSpace = false;
+
+		hash ^= (unsigned char)*p;
+		hash *= 1099511628211ULL;
+		last = *p;
+		p++;
+	}
+
+	return hash;
+}
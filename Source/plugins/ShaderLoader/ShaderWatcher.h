@@ -0,0 +1,75 @@
+//
+//		ShaderWatcher.h
+//
+//		Watches the loaded shader file and reports when it has been saved
+//		with a change that needs a recompile.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#pragma once
+#ifndef ShaderWatcher_H
+#define ShaderWatcher_H
+
+#include <windows.h>
+#include <string>
+
+class ShaderWatcher
+{
+
+public:
+
+	ShaderWatcher();
+	~ShaderWatcher();
+
+	// Watch a shader file. The source is the content just loaded from it,
+	// so only a save that changes it is reported.
+	bool Watch(const char *path, const std::string &source);
+	void Stop();
+
+	// True once after the file has been saved with a real change
+	bool HasChanged();
+
+	// Hash of the source with comments and formatting left out
+	static unsigned __int64 HashTokens(const char *source);
+
+protected:
+
+	HANDLE m_hThread;
+	HANDLE m_hStop;
+	CRITICAL_SECTION m_cs;
+	char m_folder[MAX_PATH];
+	char m_filename[MAX_PATH];
+	WCHAR m_wfilename[MAX_PATH]; // for the change records
+	unsigned __int64 m_hash;
+	volatile LONG m_changed;
+
+	static DWORD WINAPI WatchThread(LPVOID param);
+	void Run();
+	bool IsWatchedFile(const FILE_NOTIFY_INFORMATION *info);
+	bool CheckFile();
+
+};
+
+#endif
@@ -0,0 +1,128 @@
+//
+//		TexturePool.cpp
+//
+//		Textures released by plugin instances, kept for a while for reuse.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#include "TexturePool.h"
+
+
+TexturePool::TexturePool(unsigned int maxFree, unsigned int keepTime)
+{
+	m_maxFree  = maxFree;
+	m_keepTime = keepTime;
+}
+
+TexturePool::~TexturePool()
+{
+	// The context has gone by now, so the driver releases the textures
+	m_textures.clear();
+}
+
+GLuint TexturePool::Acquire(FFGLStateCache &state, GLsizei width, GLsizei height, GLint format)
+{
+	TextureEntry entry;
+
+	for(size_t i = 0; i < m_textures.size(); i++) {
+		if(!m_textures[i].bInUse && m_textures[i].width == width
+		&& m_textures[i].height == height && m_textures[i].format == format) {
+			m_textures[i].bInUse = true;
+			return m_textures[i].texture;
+		}
+	}
+
+	glGenTextures(1, &entry.texture);
+	state.BindTexture(GL_TEXTURE0, entry.texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	entry.width       = width;
+	entry.height      = height;
+	entry.format      = format;
+	entry.bInUse      = true;
+	entry.releaseTime = 0;
+	m_textures.push_back(entry);
+
+	// A good time to let go of textures that have not been wanted for a while
+	Trim();
+
+	return entry.texture;
+}
+
+void TexturePool::Release(GLuint texture)
+{
+	for(size_t i = 0; i < m_textures.size(); i++) {
+		if(m_textures[i].texture == texture) {
+			m_textures[i].bInUse = false;
+			m_textures[i].releaseTime = GetTickCount();
+			break;
+		}
+	}
+
+	Trim();
+}
+
+void TexturePool::Clear()
+{
+	for(size_t i = 0; i < m_textures.size(); i++)
+		glDeleteTextures(1, &m_textures[i].texture);
+	m_textures.clear();
+}
+
+//
+// Delete the free textures that have not been used for the keep time, and the
+// ones released longest ago while there are more free textures than the limit.
+//
+void TexturePool::Trim()
+{
+	DWORD now = GetTickCount();
+	unsigned int nFree = 0;
+
+	for(size_t i = 0; i < m_textures.size(); i++) {
+		if(!m_textures[i].bInUse)
+			nFree++;
+	}
+
+	while(nFree > 0) {
+		// The free texture released longest ago
+		size_t oldest = m_textures.size();
+		for(size_t i = 0; i < m_textures.size(); i++) {
+			if(!m_textures[i].bInUse && (oldest == m_textures.size()
+			|| now - m_textures[i].releaseTime > now - m_textures[oldest].releaseTime))
+				oldest = i;
+		}
+
+		if(nFree <= m_maxFree && now - m_textures[oldest].releaseTime < m_keepTime)
+			break;
+
+		glDeleteTextures(1, &m_textures[oldest].texture);
+		m_textures.erase(m_textures.begin() + oldest);
+		nFree--;
+	}
+}
@@ -0,0 +1,78 @@
+//
+//		TexturePool.h
+//
+//		Textures released by plugin instances, kept for a while so that an
+//		instance needing one of the same size and format can use it again
+//		instead of creating a new one.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#pragma once
+#ifndef TexturePool_H
+#define TexturePool_H
+
+#include <FFGL.h>
+#include <FFGLStateCache.h>
+#include <vector>
+
+class TexturePool
+{
+
+public:
+
+	TexturePool(unsigned int maxFree, unsigned int keepTime);
+	~TexturePool();
+
+	// A GL_TEXTURE_2D with repeat wrapping and linear filtering. The texture is
+	// created on texture unit 0 if there is no free one of the same size and format.
+	GLuint Acquire(FFGLStateCache &state, GLsizei width, GLsizei height, GLint format);
+
+	// Give a texture back. It is kept until it has not been used for the keep time
+	// or there are too many free textures.
+	void Release(GLuint texture);
+
+	// Delete every texture. Needs the OpenGL context.
+	void Clear();
+
+protected:
+
+	struct TextureEntry {
+		GLuint texture;
+		GLsizei width;
+		GLsizei height;
+		GLint format;
+		bool bInUse;
+		DWORD releaseTime;
+	};
+
+	std::vector<TextureEntry> m_textures;
+	unsigned int m_maxFree;
+	DWORD m_keepTime; // milliseconds
+
+	void Trim();
+
+};
+
+#endif
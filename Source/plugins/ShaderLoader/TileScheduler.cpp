@@ -0,0 +1,86 @@
+//
+//		TileScheduler.cpp
+//
+//		Chooses how many tiles of an image to render in a frame from the GPU
+//		time of earlier frames.
+//
+//		The time of a frame is taken to be in proportion to the tiles rendered,
+//		so the tiles that fit in the budget are the budget over the average
+//		time of a tile. The number at most doubles from one sample to the next
+//		because the tiles of a shader do not all cost the same.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#include "TileScheduler.h"
+
+#define TILESCHEDULER_SMOOTHING (0.25) // of each new sample in the average
+
+
+TileScheduler::TileScheduler()
+{
+	m_budget = 16.0;
+	Reset();
+}
+
+TileScheduler::~TileScheduler()
+{
+}
+
+void TileScheduler::SetBudget(double budget)
+{
+	m_budget = budget;
+}
+
+void TileScheduler::Reset()
+{
+	m_average = -1.0;
+	m_tiles   = 1;
+}
+
+void TileScheduler::AddSample(double ms, int tiles)
+{
+	if(tiles <= 0)
+		return;
+
+	double tileTime = ms/(double)tiles;
+	if(m_average < 0.0)
+		m_average = tileTime;
+	else
+		m_average += (tileTime - m_average)*TILESCHEDULER_SMOOTHING;
+
+	if(m_average <= 0.0)
+		return;
+
+	// Always at least one tile, or the image is never finished
+	int fit = (int)(m_budget/m_average);
+	if(fit > m_tiles*2) fit = m_tiles*2;
+	if(fit < 1) fit = 1;
+	m_tiles = fit;
+}
+
+int TileScheduler::GetTiles()
+{
+	return m_tiles;
+}
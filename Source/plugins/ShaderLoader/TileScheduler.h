@@ -0,0 +1,63 @@
+//
+//		TileScheduler.h
+//
+//		Chooses how many tiles of an image to render in a frame from the GPU
+//		time of earlier frames, so that the time spent on them stays within a budget.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#pragma once
+#ifndef TileScheduler_H
+#define TileScheduler_H
+
+class TileScheduler
+{
+
+public:
+
+	TileScheduler();
+	~TileScheduler();
+
+	// The GPU time to spend on tiles in a frame, in milliseconds
+	void SetBudget(double budget);
+
+	// Back to one tile a frame
+	void Reset();
+
+	// The GPU time of a frame and the number of tiles it rendered
+	void AddSample(double ms, int tiles);
+
+	// Tiles to render this frame
+	int GetTiles();
+
+protected:
+
+	double m_budget;
+	double m_average; // time of a tile, less than zero with no samples
+	int m_tiles;
+
+};
+
+#endif
@@ -0,0 +1,190 @@
+//
+//		UniformRing.cpp
+//
+//		A uniform buffer divided into slots that are written in turn, so that
+//		each draw can have its own uniform block without waiting for the GPU.
+//
+//		With ARB_buffer_storage the buffer is mapped once and written directly.
+//		The ring is split into UNIFORMRING_SECTIONS parts with a fence for
+//		each, so a slot is only written again once the draws that used it
+//		have finished. That only waits if the GPU is more than two thirds of
+//		the ring behind. Without it, glBufferSubData leaves the synchronisation
+//		to the driver.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#include <stdio.h>
+#include <string.h>
+
+#include "UniformRing.h"
+#include <FFGLExtensions.h>
+
+// ARB_buffer_storage is not in GLee
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT   0x0080
+#endif
+typedef void (APIENTRY *PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+UniformRing::UniformRing()
+{
+	m_buffer    = 0;
+	m_blockSize = 0;
+	m_stride    = 0;
+	m_nSlots    = 0;
+	m_nextSlot  = 0;
+	m_bStarted  = false;
+	m_mapped    = NULL;
+	for(int i = 0; i < UNIFORMRING_SECTIONS; i++)
+		m_fences[i] = 0;
+}
+
+UniformRing::~UniformRing()
+{
+	// The context has gone by now, so the driver releases the buffer
+}
+
+bool UniformRing::Create(GLsizeiptr blockSize, int nSlots)
+{
+	GLint alignment = 0;
+	PFNGLBUFFERSTORAGEPROC glBufferStorage = NULL;
+
+	if(m_buffer)
+		return true;
+
+	if(!GLEE_ARB_uniform_buffer_object || !GLEE_ARB_map_buffer_range || !GLEE_ARB_sync)
+		return false;
+
+	// Whole sections
+	nSlots = ((nSlots + UNIFORMRING_SECTIONS - 1)/UNIFORMRING_SECTIONS)*UNIFORMRING_SECTIONS;
+
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if(alignment <= 0) alignment = 256;
+
+	m_blockSize = blockSize;
+	m_stride    = ((blockSize + alignment - 1)/alignment)*alignment;
+	m_nSlots    = nSlots;
+	m_nextSlot  = 0;
+	m_bStarted  = false;
+
+	if(FFGLExtensions::HasExtension("GL_ARB_buffer_storage"))
+		glBufferStorage = (PFNGLBUFFERSTORAGEPROC)wglGetProcAddress("glBufferStorage");
+
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+
+	if(glBufferStorage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_UNIFORM_BUFFER, m_stride*m_nSlots, NULL, flags);
+		m_mapped = (char *)glMapBufferRange(GL_UNIFORM_BUFFER, 0, m_stride*m_nSlots, flags);
+	}
+
+	if(!m_mapped) {
+		// A buffer made with glBufferStorage cannot be resized, so start again
+		if(glBufferStorage) {
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			glDeleteBuffers(1, &m_buffer);
+			glGenBuffers(1, &m_buffer);
+			glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+		}
+		glBufferData(GL_UNIFORM_BUFFER, m_stride*m_nSlots, NULL, GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	printf("Uniform ring %d x %d bytes%s\n", m_nSlots, (int)m_stride, m_mapped ? " (mapped)" : "");
+
+	return true;
+}
+
+void UniformRing::Release()
+{
+	for(int i = 0; i < UNIFORMRING_SECTIONS; i++) {
+		if(m_fences[i]) glDeleteSync(m_fences[i]);
+		m_fences[i] = 0;
+	}
+
+	if(m_buffer) {
+		if(m_mapped) {
+			glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &m_buffer);
+	}
+
+	m_buffer = 0;
+	m_mapped = NULL;
+}
+
+bool UniformRing::IsReady()
+{
+	return (m_buffer != 0);
+}
+
+bool UniformRing::Bind(GLuint binding, const void *data)
+{
+	if(!m_buffer)
+		return false;
+
+	int slotsPerSection = m_nSlots/UNIFORMRING_SECTIONS;
+	GLintptr offset = m_stride*m_nextSlot;
+
+	if(m_mapped && m_nextSlot % slotsPerSection == 0) {
+		int section = m_nextSlot/slotsPerSection;
+
+		// The draws using the previous section have all been issued now
+		if(m_bStarted) {
+			int previous = (section + UNIFORMRING_SECTIONS - 1) % UNIFORMRING_SECTIONS;
+			if(m_fences[previous]) glDeleteSync(m_fences[previous]);
+			m_fences[previous] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+
+		// Wait for the GPU to finish with this section
+		if(m_fences[section]) {
+			glClientWaitSync(m_fences[section], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000); // 1 second
+			glDeleteSync(m_fences[section]);
+			m_fences[section] = 0;
+		}
+	}
+
+	if(m_mapped) {
+		memcpy(m_mapped + offset, data, m_blockSize);
+	}
+	else {
+		glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, m_blockSize, data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_buffer, offset, m_blockSize);
+
+	m_bStarted = true;
+	m_nextSlot++;
+	if(m_nextSlot >= m_nSlots)
+		m_nextSlot = 0;
+
+	return true;
+}
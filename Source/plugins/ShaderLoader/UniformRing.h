@@ -0,0 +1,69 @@
+//
+//		UniformRing.h
+//
+//		A uniform buffer divided into slots that are written in turn, so that
+//		each draw can have its own uniform block without waiting for the GPU.
+//
+//		------------------------------------------------------------
+//
+//		Redistribution and use in source and binary forms, with or without modification, 
+//		are permitted provided that the following conditions are met:
+//
+//		1. Redistributions of source code must retain the above copyright notice, 
+//		   this list of conditions and the following disclaimer.
+//
+//		2. Redistributions in binary form must reproduce the above copyright notice, 
+//		   this list of conditions and the following disclaimer in the documentation 
+//		   and/or other materials provided with the distribution.
+//
+//		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"	AND ANY 
+//		EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+//		OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE	ARE DISCLAIMED. 
+//		IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+//		INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+//		PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+//		INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//		LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+//		OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+//		--------------------------------------------------------------
+//
+#pragma once
+#ifndef UniformRing_H
+#define UniformRing_H
+
+#include <FFGL.h>
+
+#define UNIFORMRING_SECTIONS 3 // parts of the ring fenced separately
+
+class UniformRing
+{
+
+public:
+
+	UniformRing();
+	~UniformRing();
+
+	// Needs ARB_uniform_buffer_object. Uses a persistently mapped buffer if
+	// ARB_buffer_storage is available, otherwise glBufferSubData.
+	bool Create(GLsizeiptr blockSize, int nSlots);
+	void Release();
+	bool IsReady();
+
+	// Copy a block into the next slot and bind that slot to a uniform block binding point
+	bool Bind(GLuint binding, const void *data);
+
+protected:
+
+	GLuint m_buffer;
+	GLsizeiptr m_blockSize;
+	GLsizeiptr m_stride;   // block size rounded up to the offset alignment
+	int m_nSlots;
+	int m_nextSlot;
+	bool m_bStarted;
+	char *m_mapped;        // persistent mapping or NULL
+	GLsync m_fences[UNIFORMRING_SECTIONS];
+
+};
+
+#endif